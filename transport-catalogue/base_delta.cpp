@@ -0,0 +1,258 @@
+#include "base_delta.h"
+#include "serialization.h"
+#include "perfect_hash.h"
+
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace serialization {
+    
+namespace {
+constexpr string_view DELTA_MAGIC{"TCDELTA\0", 8};
+    
+// Справочник базы, в котором остановки и автобусы адресуются по именам
+struct NamedCatalogue {
+    vector<string> stop_order;
+    unordered_map<string, proto_serialization::Stop> stops;
+    vector<string> bus_order;
+    unordered_map<string, proto_serialization::DeltaBus> buses;
+    map<pair<string, string>, uint32_t> distances;
+};
+    
+string ReadFile(const string& file) {
+    ifstream input(file, ios::binary);
+    if (!input) {
+        throw runtime_error("Cannot open base file " + file);
+    }
+    return string(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+}
+    
+const string& StopName(const proto_serialization::TransportCatalogue& base, uint32_t id) {
+    if (id >= static_cast<uint32_t>(base.stops_size())) {
+        throw runtime_error("Stop id is out of range");
+    }
+    return base.stops(static_cast<int>(id)).name();
+}
+    
+NamedCatalogue ToNamed(const proto_serialization::TransportCatalogue& base) {
+    const bool indexed = base.version() >= INDEXED_VERSION;
+    NamedCatalogue named;
+    
+    named.stop_order.reserve(base.stops_size());
+    for (const auto& stop : base.stops()) {
+        named.stop_order.push_back(stop.name());
+        named.stops.emplace(stop.name(), stop);
+    }
+    
+    named.bus_order.reserve(base.buses_size());
+    for (const auto& bus : base.buses()) {
+        proto_serialization::DeltaBus& named_bus = named.buses[bus.name()];
+        named_bus.set_name(bus.name());
+        named_bus.set_is_circular(bus.is_circular());
+        if (indexed) {
+            for (uint32_t id : bus.stop_ids()) {
+                named_bus.add_stops(StopName(base, id));
+            }
+        } else {
+            for (const auto& stop : bus.stops()) {
+                named_bus.add_stops(stop.name());
+            }
+        }
+        named.bus_order.push_back(bus.name());
+    }
+    
+    for (const auto& distance : base.distances()) {
+        if (indexed) {
+            named.distances[{StopName(base, distance.from_id()), StopName(base, distance.to_id())}] = distance.distance();
+        } else {
+            named.distances[{distance.from(), distance.to()}] = distance.distance();
+        }
+    }
+    return named;
+}
+    
+void FromNamed(const NamedCatalogue& named, proto_serialization::TransportCatalogue& base) {
+    base.clear_stops();
+    base.clear_buses();
+    base.clear_distances();
+    base.clear_stop_index();
+    base.clear_bus_index();
+    base.clear_transport_router();
+    base.set_version(INDEXED_VERSION);
+    
+    unordered_map<string_view, uint32_t> stop_ids;
+    auto get_stop_id = [&stop_ids](const string& name) {
+        const auto it = stop_ids.find(name);
+        if (it == stop_ids.end()) {
+            throw runtime_error("Delta refers to unknown stop " + name);
+        }
+        return it->second;
+    };
+    
+    base.mutable_stops()->Reserve(static_cast<int>(named.stops.size()));
+    for (const string& name : named.stop_order) {
+        const auto it = named.stops.find(name);
+        if (it != named.stops.end() && !stop_ids.count(it->first)) {
+            stop_ids.emplace(it->first, static_cast<uint32_t>(base.stops_size()));
+            *base.add_stops() = it->second;
+        }
+    }
+    
+    // Удалённое и снова добавленное имя встречается в порядке дважды
+    unordered_set<string_view> added_buses;
+    base.mutable_buses()->Reserve(static_cast<int>(named.buses.size()));
+    for (const string& name : named.bus_order) {
+        const auto it = named.buses.find(name);
+        if (it == named.buses.end() || !added_buses.insert(it->first).second) {
+            continue;
+        }
+        proto_serialization::Bus* bus = base.add_buses();
+        bus->set_name(name);
+        bus->set_is_circular(it->second.is_circular());
+        bus->mutable_stop_ids()->Reserve(it->second.stops_size());
+        for (const string& stop : it->second.stops()) {
+            bus->add_stop_ids(get_stop_id(stop));
+        }
+    }
+    
+    base.mutable_distances()->Reserve(static_cast<int>(named.distances.size()));
+    for (const auto& [stops, dist] : named.distances) {
+        proto_serialization::Distance* distance = base.add_distances();
+        distance->set_from_id(get_stop_id(stops.first));
+        distance->set_to_id(get_stop_id(stops.second));
+        distance->set_distance(dist);
+    }
+}
+    
+proto_serialization::Distance MakeDistance(const pair<string, string>& stops, uint32_t dist) {
+    proto_serialization::Distance distance;
+    distance.set_from(stops.first);
+    distance.set_to(stops.second);
+    distance.set_distance(dist);
+    return distance;
+}
+    
+} // namespace
+    
+uint64_t HashBaseFile(const string& file) {
+    return phash::Hash(ReadFile(file), 0);
+}
+    
+proto_serialization::BaseDelta MakeDelta(const proto_serialization::TransportCatalogue& parent,
+                                         const proto_serialization::TransportCatalogue& current) {
+    const NamedCatalogue before = ToNamed(parent);
+    const NamedCatalogue after = ToNamed(current);
+    proto_serialization::BaseDelta delta;
+    
+    for (const string& name : after.stop_order) {
+        const auto it = before.stops.find(name);
+        const auto& stop = after.stops.at(name);
+        if (it == before.stops.end() || it->second.SerializeAsString() != stop.SerializeAsString()) {
+            *delta.add_upserted_stops() = stop;
+        }
+    }
+    for (const string& name : before.stop_order) {
+        if (!after.stops.count(name)) {
+            delta.add_removed_stops(name);
+        }
+    }
+    
+    for (const string& name : after.bus_order) {
+        const auto it = before.buses.find(name);
+        const auto& bus = after.buses.at(name);
+        if (it == before.buses.end() || it->second.SerializeAsString() != bus.SerializeAsString()) {
+            *delta.add_upserted_buses() = bus;
+        }
+    }
+    for (const string& name : before.bus_order) {
+        if (!after.buses.count(name)) {
+            delta.add_removed_buses(name);
+        }
+    }
+    
+    for (const auto& [stops, dist] : after.distances) {
+        const auto it = before.distances.find(stops);
+        if (it == before.distances.end() || it->second != dist) {
+            *delta.add_upserted_distances() = MakeDistance(stops, dist);
+        }
+    }
+    for (const auto& [stops, dist] : before.distances) {
+        if (!after.distances.count(stops)) {
+            *delta.add_removed_distances() = MakeDistance(stops, dist);
+        }
+    }
+    
+    if (parent.render_settings().SerializeAsString() != current.render_settings().SerializeAsString()) {
+        *delta.mutable_render_settings() = current.render_settings();
+    }
+    if (parent.router_settings().SerializeAsString() != current.router_settings().SerializeAsString()) {
+        *delta.mutable_router_settings() = current.router_settings();
+    }
+    return delta;
+}
+    
+void ApplyDelta(const proto_serialization::BaseDelta& delta, proto_serialization::TransportCatalogue& base) {
+    NamedCatalogue named = ToNamed(base);
+    
+    for (const string& name : delta.removed_stops()) {
+        named.stops.erase(name);
+    }
+    for (const auto& stop : delta.upserted_stops()) {
+        if (!named.stops.count(stop.name())) {
+            named.stop_order.push_back(stop.name());
+        }
+        named.stops[stop.name()] = stop;
+    }
+    
+    for (const string& name : delta.removed_buses()) {
+        named.buses.erase(name);
+    }
+    for (const auto& bus : delta.upserted_buses()) {
+        if (!named.buses.count(bus.name())) {
+            named.bus_order.push_back(bus.name());
+        }
+        named.buses[bus.name()] = bus;
+    }
+    
+    for (const auto& distance : delta.removed_distances()) {
+        named.distances.erase({distance.from(), distance.to()});
+    }
+    for (const auto& distance : delta.upserted_distances()) {
+        named.distances[{distance.from(), distance.to()}] = distance.distance();
+    }
+    
+    FromNamed(named, base);
+    if (delta.has_render_settings()) {
+        *base.mutable_render_settings() = delta.render_settings();
+    }
+    if (delta.has_router_settings()) {
+        *base.mutable_router_settings() = delta.router_settings();
+    }
+}
+    
+void WriteDelta(const string& file, const proto_serialization::BaseDelta& delta) {
+    ofstream output(file, ios::binary);
+    output.write(DELTA_MAGIC.data(), DELTA_MAGIC.size());
+    delta.SerializeToOstream(&output);
+}
+    
+proto_serialization::BaseDelta ReadDelta(const string& file) {
+    const string data = ReadFile(file);
+    proto_serialization::BaseDelta delta;
+    if (data.compare(0, DELTA_MAGIC.size(), DELTA_MAGIC) != 0
+        || !delta.ParseFromArray(data.data() + DELTA_MAGIC.size(), static_cast<int>(data.size() - DELTA_MAGIC.size()))) {
+        throw runtime_error("Malformed base delta " + file);
+    }
+    return delta;
+}
+    
+} // namespace serialization
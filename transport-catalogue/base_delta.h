@@ -0,0 +1,24 @@
+#pragma once
+
+#include "transport_catalogue.pb.h"
+
+#include <cstdint>
+#include <string>
+
+namespace serialization {
+    
+// Хеш содержимого файла базы или дельты, по нему дельта привязывается к родителю
+uint64_t HashBaseFile(const std::string& file);
+    
+// Изменения, превращающие parent в current
+proto_serialization::BaseDelta MakeDelta(const proto_serialization::TransportCatalogue& parent,
+                                         const proto_serialization::TransportCatalogue& current);
+    
+// Накладывает дельту на base. Номера остановок и автобусов меняются,
+// поэтому индексы имён и граф из base сбрасываются
+void ApplyDelta(const proto_serialization::BaseDelta& delta, proto_serialization::TransportCatalogue& base);
+    
+void WriteDelta(const std::string& file, const proto_serialization::BaseDelta& delta);
+proto_serialization::BaseDelta ReadDelta(const std::string& file);
+    
+} // namespace serialization
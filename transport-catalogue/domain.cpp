@@ -6,6 +6,48 @@
 
 namespace tcat {
 
+RouteStopIterator::RouteStopIterator(const std::vector<Stop*>& stops, size_t index) :
+                    stops_(&stops), index_(index) {}
+    
+Stop* RouteStopIterator::operator*() const {
+    const size_t size = stops_->size();
+    return (*stops_)[index_ < size ? index_ : 2 * size - 2 - index_];
+}
+    
+RouteStopIterator& RouteStopIterator::operator++() {
+    ++index_;
+    return *this;
+}
+    
+RouteStopIterator RouteStopIterator::operator++(int) {
+    RouteStopIterator result = *this;
+    ++index_;
+    return result;
+}
+    
+bool RouteStopIterator::operator==(const RouteStopIterator& other) const {
+    return stops_ == other.stops_ && index_ == other.index_;
+}
+    
+bool RouteStopIterator::operator!=(const RouteStopIterator& other) const {
+    return !(*this == other);
+}
+    
+size_t Bus::GetRouteSize() const {
+    if (is_circular || stops.empty()) {
+        return stops.size();
+    }
+    return stops.size() * 2 - 1;
+}
+    
+Stop* Bus::GetRouteStop(size_t index) const {
+    return *RouteStopIterator(stops, index);
+}
+    
+ranges::Range<RouteStopIterator> Bus::GetRoute() const {
+    return {RouteStopIterator(stops, 0), RouteStopIterator(stops, GetRouteSize())};
+}
+
 BusInfo::BusInfo(std::string_view name, int stops, int unique_stops, int route_length, double curvature) :
                     name(name), stops(stops), unique_stops(unique_stops), route_length(route_length), curvature(curvature) {}
     
@@ -5,14 +5,18 @@
 #include <unordered_map>
 #include <set>
 #include <functional>
+#include <iterator>
+#include <cstddef>
 
 #include "geo.h"
+#include "ranges.h"
 
 namespace tcat {
  
 struct Stop {
     std::string name;
-    geo::Coordinates coordinates;
+    geo::StoredCoordinates coordinates;
+    size_t id = 0;
 };
     
 struct PreBus {
@@ -21,14 +25,44 @@ struct PreBus {
     bool is_circular;
 };
     
+// Обходит остановки маршрута так, как их проезжает автобус:
+// некольцевой маршрут хранится один раз и проходится туда и обратно
+class RouteStopIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Stop*;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Stop* const*;
+    using reference = Stop*;
+    
+    RouteStopIterator(const std::vector<Stop*>& stops, size_t index);
+    
+    Stop* operator*() const;
+    RouteStopIterator& operator++();
+    RouteStopIterator operator++(int);
+    
+    bool operator==(const RouteStopIterator& other) const;
+    bool operator!=(const RouteStopIterator& other) const;
+    
+private:
+    const std::vector<Stop*>* stops_;
+    size_t index_;
+};
+    
 struct Bus {
     std::string name;
+    // Для некольцевого маршрута — только путь в одну сторону
     std::vector<Stop*> stops;
     int number_of_stops = 0;
     int unique_stops = 0;
     int route_length = 0;
     double curvature = 0;
     bool is_circular;
+    size_t id = 0;
+    
+    size_t GetRouteSize() const;
+    Stop* GetRouteStop(size_t index) const;
+    ranges::Range<RouteStopIterator> GetRoute() const;
 };
     
 struct BusInfo {
@@ -58,7 +92,8 @@ struct StopDistances {
 };
     
 struct RenderData {
-    std::vector<geo::Coordinates> stop_coords;
+    // Остановки в том же порядке, что и Bus::stops
+    std::vector<geo::StoredCoordinates> stop_coords;
     std::vector<std::string> stop_names;
     bool is_circular = false;
 };
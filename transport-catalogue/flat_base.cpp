@@ -0,0 +1,441 @@
+#include "flat_base.h"
+#include "serialization.h"
+#include "map_renderer.pb.h"
+#include "transport_router.pb.h"
+#include "perfect_hash.h"
+#include "graph.h"
+#include "router.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace serialization {
+    
+namespace {
+using namespace flat;
+using RouteEntry = graph::Router<double>::RouteEntry;
+    
+static_assert(is_trivially_copyable_v<RouteEntry> && sizeof(RouteEntry) == 24,
+              "Routes table entries are stored in the base as is");
+    
+uint64_t Align(uint64_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+    
+template <typename T>
+void AppendRecords(string& section, const T* records, size_t count) {
+    static_assert(is_trivially_copyable_v<T>);
+    section.append(reinterpret_cast<const char*>(records), count * sizeof(T));
+}
+    
+template <typename T>
+void AppendRecord(string& section, const T& record) {
+    AppendRecords(section, &record, 1);
+}
+    
+void AppendNameIndex(string& section, const phash::NameIndex& index) {
+    AppendRecord(section, static_cast<uint64_t>(index.Size()));
+    AppendRecords(section, index.GetDisplacements().data(), index.Size());
+    AppendRecords(section, index.GetIds().data(), index.Size());
+    AppendRecords(section, index.GetFingerprints().data(), index.Size());
+}
+    
+class FlatBaseReader {
+public:
+    explicit FlatBaseReader(shared_ptr<const MappedFile> file) : file_(move(file)) {
+        if (file_->Size() < sizeof(Header)) {
+            throw runtime_error("Base file is too small");
+        }
+        const auto* header = reinterpret_cast<const Header*>(file_->Data());
+        if (header->magic != MAGIC || header->version != VERSION) {
+            throw runtime_error("Unsupported base file format");
+        }
+        if (sizeof(Header) + header->section_count * sizeof(SectionEntry) > file_->Size()) {
+            throw runtime_error("Base file table of contents is truncated");
+        }
+        const auto* entries = reinterpret_cast<const SectionEntry*>(file_->Data() + sizeof(Header));
+        for (uint32_t i = 0; i < header->section_count; ++i) {
+            const SectionEntry& entry = entries[i];
+            if (entry.offset > file_->Size() || entry.size > file_->Size() - entry.offset) {
+                throw runtime_error("Base file section is out of bounds");
+            }
+            if (entry.id < sections_.size()) {
+                sections_[entry.id] = {file_->Data() + entry.offset, entry.size};
+            }
+        }
+    }
+    
+    string_view Section(SectionId id) const {
+        return sections_[static_cast<size_t>(id)];
+    }
+    
+    template <typename T>
+    pair<const T*, size_t> Records(string_view data) const {
+        if (data.size() % sizeof(T) != 0 || reinterpret_cast<uintptr_t>(data.data()) % alignof(T) != 0) {
+            throw runtime_error("Malformed base file section");
+        }
+        return {reinterpret_cast<const T*>(data.data()), data.size() / sizeof(T)};
+    }
+    
+    template <typename T>
+    pair<const T*, size_t> Records(SectionId id) const {
+        return Records<T>(Section(id));
+    }
+    
+    string_view Name(NameRef ref) const {
+        const string_view names = Section(SectionId::NAMES);
+        if (ref.offset > names.size() || ref.size > names.size() - ref.offset) {
+            throw runtime_error("Name is out of bounds");
+        }
+        return names.substr(ref.offset, ref.size);
+    }
+    
+    phash::NameIndex ReadNameIndex(SectionId id) const {
+        string_view data = Section(id);
+        if (data.empty()) {
+            return {};
+        }
+        const auto [count_ptr, _] = Records<uint64_t>(data.substr(0, sizeof(uint64_t)));
+        const uint64_t count = *count_ptr;
+        data.remove_prefix(sizeof(uint64_t));
+        // Произведение count на размер записи может переполниться, поэтому сравнивается частное
+        constexpr size_t record_size = sizeof(int32_t) + 2 * sizeof(uint32_t);
+        if (data.size() % record_size != 0 || data.size() / record_size != count) {
+            throw runtime_error("Malformed name index");
+        }
+        const auto [displacements, _1] = Records<int32_t>(data.substr(0, count * sizeof(int32_t)));
+        const auto [ids, _2] = Records<uint32_t>(data.substr(count * sizeof(int32_t), count * sizeof(uint32_t)));
+        const auto [fingerprints, _3] = Records<uint32_t>(data.substr(count * (sizeof(int32_t) + sizeof(uint32_t))));
+        try {
+            return phash::NameIndex({displacements, displacements + count}, {ids, ids + count},
+                                    {fingerprints, fingerprints + count});
+        } catch (const invalid_argument&) {
+            throw runtime_error("Malformed name index");
+        }
+    }
+    
+    // Граф вместе с таблицей маршрутов; nullopt, если таблицы в базе нет или она не подходит к графу
+    optional<graph::DirectedWeightedGraph<double>> ReadGraph() const {
+        const auto [edge_records, edges_count] = Records<EdgeRecord>(SectionId::GRAPH_EDGES);
+        const auto [incidence, incidence_size] = Records<uint64_t>(SectionId::GRAPH_INCIDENCE);
+        const size_t routes_table_size = Records<RouteEntry>(SectionId::ROUTES_TABLE).second;
+        const uint64_t vertex_count = incidence_size > 0 ? incidence[0] : 0;
+        if (incidence_size == 0 || incidence_size < vertex_count + 2
+            || routes_table_size != vertex_count * vertex_count) {
+            return nullopt;
+        }
+    
+        vector<graph::Edge<double>> edges;
+        edges.reserve(edges_count);
+        for (size_t i = 0; i < edges_count; ++i) {
+            const EdgeRecord& record = edge_records[i];
+            if (record.from >= vertex_count || record.to >= vertex_count) {
+                throw runtime_error("Edge vertex is out of range");
+            }
+            edges.push_back({
+                record.from,
+                record.to,
+                string(Name(record.name)),
+                static_cast<graph::EdgeType>(record.type),
+                record.span_count,
+                record.weight
+            });
+        }
+        const uint64_t* offsets = incidence + 1;
+        const uint64_t* edge_ids = offsets + vertex_count + 1;
+        if (offsets[vertex_count] != incidence_size - vertex_count - 2) {
+            throw runtime_error("Malformed incidence lists");
+        }
+        vector<vector<graph::EdgeId>> incidence_lists(vertex_count);
+        for (uint64_t vertex = 0; vertex < vertex_count; ++vertex) {
+            if (offsets[vertex] > offsets[vertex + 1]) {
+                throw runtime_error("Malformed incidence lists");
+            }
+            for (uint64_t i = offsets[vertex]; i < offsets[vertex + 1]; ++i) {
+                if (edge_ids[i] >= edges_count) {
+                    throw runtime_error("Incident edge is out of range");
+                }
+            }
+            incidence_lists[vertex].assign(edge_ids + offsets[vertex], edge_ids + offsets[vertex + 1]);
+        }
+        // Маршрут восстанавливается по prev_edge, поэтому каждое ребро должно существовать и вести
+        // в вершину своего столбца
+        const RouteEntry* routes_table = Records<RouteEntry>(SectionId::ROUTES_TABLE).first;
+        for (uint64_t i = 0; i < routes_table_size; ++i) {
+            const RouteEntry& entry = routes_table[i];
+            if (entry.has_prev_edge && (!entry.has_route || entry.prev_edge >= edges_count
+                                        || edges[entry.prev_edge].to != i % vertex_count)) {
+                throw runtime_error("Malformed routes table");
+            }
+        }
+    
+        return graph::DirectedWeightedGraph<double>(move(edges), move(incidence_lists));
+    }
+    
+private:
+    shared_ptr<const MappedFile> file_;
+    array<string_view, static_cast<size_t>(SectionId::COUNT)> sections_;
+};
+}
+    
+MappedFile::MappedFile(const string& file) {
+    const int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Cannot open base file " + file);
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw runtime_error("Cannot stat base file " + file);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw runtime_error("Cannot map base file " + file);
+        }
+        data_ = static_cast<const char*>(data);
+    }
+    close(fd);
+}
+    
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+    
+const char* MappedFile::Data() const {
+    return data_;
+}
+    
+size_t MappedFile::Size() const {
+    return size_;
+}
+    
+bool IsFlatBase(const string& file) {
+    ifstream ifs(file, ios::binary);
+    array<char, 8> magic{};
+    ifs.read(magic.data(), magic.size());
+    return ifs && magic == MAGIC;
+}
+    
+FlatSerializer::FlatSerializer(tcat::TransportCatalogue& catalogue, shared_ptr<router::TransportRouter> tr, map_r::MapRenderer& map_renderer)
+        : tc_(catalogue), tr_ptr_(tr), mr_(map_renderer) {}
+    
+void FlatSerializer::EncodeCatalogueSections() {
+    for (const tcat::Stop& stop : tc_.GetAllStops()) {
+        const geo::Coordinates coords = geo::ToCoordinates(stop.coordinates);
+        AppendRecord(Section(SectionId::STOPS), StopRecord{AddName(stop.name), coords.lat, coords.lng});
+    }
+    
+    uint64_t bus_stops_count = 0;
+    for (const tcat::Bus& bus : tc_.GetAllBuses()) {
+        AppendRecord(Section(SectionId::BUSES), BusRecord{
+            AddName(bus.name),
+            bus_stops_count,
+            bus.stops.size(),
+            bus.number_of_stops,
+            bus.unique_stops,
+            bus.route_length,
+            bus.is_circular,
+            bus.curvature
+        });
+        for (const tcat::Stop* stop_ptr : bus.stops) {
+            AppendRecord(Section(SectionId::BUS_STOPS), static_cast<uint32_t>(stop_ptr->id));
+        }
+        bus_stops_count += bus.stops.size();
+    }
+    
+    for (const auto& [stops_pair, distance] : tc_.GetAllDistances()) {
+        AppendRecord(Section(SectionId::DISTANCES), DistanceRecord{
+            static_cast<uint32_t>(stops_pair.first->id),
+            static_cast<uint32_t>(stops_pair.second->id),
+            distance
+        });
+    }
+    
+    AppendNameIndex(Section(SectionId::STOP_INDEX), tc_.GetStopIndex());
+    AppendNameIndex(Section(SectionId::BUS_INDEX), tc_.GetBusIndex());
+    
+    Section(SectionId::RENDER_SETTINGS) = SerializeRenderSettings(mr_.GetSettings()).SerializeAsString();
+    Section(SectionId::ROUTER_SETTINGS) = SerializeRouterSettings(tr_ptr_->GetSettings()).SerializeAsString();
+}
+    
+void FlatSerializer::EncodeRouterSections() {
+    tr_ptr_->BuildRouter();
+    
+    const auto& graph = tr_ptr_->GetGraph();
+    for (graph::EdgeId id = 0; id < graph.GetEdgeCount(); ++id) {
+        const auto& edge = graph.GetEdge(id);
+        AppendRecord(Section(SectionId::GRAPH_EDGES), EdgeRecord{
+            edge.from,
+            edge.to,
+            AddName(edge.name),
+            static_cast<uint32_t>(edge.type),
+            edge.span_count,
+            edge.weight
+        });
+    }
+    // Списки инцидентности в формате CSR: число вершин, смещения, номера рёбер
+    string& incidence = Section(SectionId::GRAPH_INCIDENCE);
+    AppendRecord(incidence, static_cast<uint64_t>(graph.GetVertexCount()));
+    uint64_t incidence_offset = 0;
+    for (graph::VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+        AppendRecord(incidence, incidence_offset);
+        for ([[maybe_unused]] graph::EdgeId id : graph.GetIncidentEdges(vertex)) {
+            ++incidence_offset;
+        }
+    }
+    AppendRecord(incidence, incidence_offset);
+    for (graph::VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+        for (graph::EdgeId id : graph.GetIncidentEdges(vertex)) {
+            AppendRecord(incidence, static_cast<uint64_t>(id));
+        }
+    }
+    
+    const graph::Router<double>* router = tr_ptr_->GetRouter();
+    AppendRecords(Section(SectionId::ROUTES_TABLE), router->GetRoutesTable(), router->GetRoutesTableSize());
+}
+    
+void FlatSerializer::EncodeRenderedMapSection() {
+    if (const auto& rendered_map = mr_.GetRenderedMap()) {
+        Section(SectionId::RENDERED_MAP) = *rendered_map;
+    }
+}
+    
+void FlatSerializer::WriteEncodedSections(const string& file) {
+    const Header header{MAGIC, VERSION, static_cast<uint32_t>(SectionId::COUNT)};
+    vector<SectionEntry> entries;
+    uint64_t offset = Align(sizeof(Header) + sections_.size() * sizeof(SectionEntry));
+    for (size_t id = 0; id < sections_.size(); ++id) {
+        entries.push_back({static_cast<uint32_t>(id), 0, offset, sections_[id].size()});
+        offset = Align(offset + sections_[id].size());
+    }
+    
+    ofstream ofs(file, ios::binary);
+    string head;
+    AppendRecord(head, header);
+    AppendRecords(head, entries.data(), entries.size());
+    ofs.write(head.data(), head.size());
+    uint64_t written = head.size();
+    for (size_t id = 0; id < sections_.size(); ++id) {
+        const string padding(entries[id].offset - written, '\0');
+        ofs.write(padding.data(), padding.size());
+        ofs.write(sections_[id].data(), sections_[id].size());
+        written = entries[id].offset + sections_[id].size();
+    }
+}
+    
+string& FlatSerializer::Section(SectionId id) {
+    return sections_[static_cast<size_t>(id)];
+}
+    
+NameRef FlatSerializer::AddName(string_view name) {
+    string& names = Section(SectionId::NAMES);
+    const auto [it, inserted] = name_refs_.emplace(name, NameRef{names.size(), name.size()});
+    if (inserted) {
+        names.append(name);
+    }
+    return it->second;
+}
+    
+shared_ptr<router::TransportRouter> FlatSerializer::DeserializeFromFile(const string& file, BaseParts parts) {
+    auto mapped_file = make_shared<const MappedFile>(file);
+    const FlatBaseReader reader(mapped_file);
+    
+    // Граф не зависит от справочника и собирается параллельно с ним
+    future<optional<graph::DirectedWeightedGraph<double>>> graph;
+    if (parts.router) {
+        graph = async(launch::async, [&reader] { return reader.ReadGraph(); });
+    }
+    
+    const auto [stops, stops_count] = reader.Records<StopRecord>(SectionId::STOPS);
+    const auto [buses, buses_count] = reader.Records<BusRecord>(SectionId::BUSES);
+    phash::NameIndex stop_index = reader.ReadNameIndex(SectionId::STOP_INDEX);
+    phash::NameIndex bus_index = reader.ReadNameIndex(SectionId::BUS_INDEX);
+    const bool has_name_index = stop_index.Size() == stops_count && bus_index.Size() == buses_count;
+    if (has_name_index) {
+        tc_.SetNameIndex(move(stop_index), move(bus_index));
+    }
+    
+    for (size_t i = 0; i < stops_count; ++i) {
+        tc_.AddStop({string(reader.Name(stops[i].name)), geo::ToStored(geo::Coordinates{stops[i].lat, stops[i].lng})});
+    }
+    
+    const auto [distances, distances_count] = reader.Records<DistanceRecord>(SectionId::DISTANCES);
+    for (size_t i = 0; i < distances_count; ++i) {
+        tc_.AddDistance(tc_.GetStop(distances[i].from), tc_.GetStop(distances[i].to), distances[i].distance);
+    }
+    
+    const auto [bus_stops, bus_stops_count] = reader.Records<uint32_t>(SectionId::BUS_STOPS);
+    for (size_t i = 0; i < buses_count; ++i) {
+        const BusRecord& record = buses[i];
+        if (record.stops_offset > bus_stops_count || record.stops_count > bus_stops_count - record.stops_offset) {
+            throw runtime_error("Bus stops are out of bounds");
+        }
+        tcat::Bus bus;
+        bus.name = string(reader.Name(record.name));
+        bus.stops.reserve(record.stops_count);
+        for (uint64_t j = 0; j < record.stops_count; ++j) {
+            bus.stops.push_back(tc_.GetStop(bus_stops[record.stops_offset + j]));
+        }
+        bus.number_of_stops = record.number_of_stops;
+        bus.unique_stops = record.unique_stops;
+        bus.route_length = record.route_length;
+        bus.curvature = record.curvature;
+        bus.is_circular = record.is_circular != 0;
+        tc_.AddBus(move(bus));
+    }
+    if (!has_name_index) {
+        tc_.BuildNameIndex();
+    }
+    
+    if (parts.render_settings) {
+        proto_serialization::RenderSettings render_settings;
+        const string_view render_data = reader.Section(SectionId::RENDER_SETTINGS);
+        render_settings.ParseFromArray(render_data.data(), static_cast<int>(render_data.size()));
+        mr_.LoadSettings(DeserializeRenderSettings(render_settings));
+        if (const string_view rendered_map = reader.Section(SectionId::RENDERED_MAP); !rendered_map.empty()) {
+            mr_.SetRenderedMap(string(rendered_map));
+        }
+    }
+    if (!parts.router) {
+        return nullptr;
+    }
+    
+    proto_serialization::RouterSettings router_settings;
+    const string_view router_data = reader.Section(SectionId::ROUTER_SETTINGS);
+    router_settings.ParseFromArray(router_data.data(), static_cast<int>(router_data.size()));
+    
+    optional<graph::DirectedWeightedGraph<double>> decoded_graph = graph.get();
+    if (!decoded_graph) {
+        auto tr = make_shared<router::TransportRouter>(tc_);
+        tr->LoadSettings(DeserializeRouterSettings(router_settings));
+        return tr;
+    }
+    
+    auto tr = make_shared<router::TransportRouter>(tc_, move(*decoded_graph),
+        reader.Records<RouteEntry>(SectionId::ROUTES_TABLE).first, mapped_file);
+    tr->LoadSettings(DeserializeRouterSettings(router_settings));
+    return tr;
+}
+    
+} // namespace serialization
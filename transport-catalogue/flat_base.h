@@ -0,0 +1,146 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+#include "map_renderer.h"
+#include "serialization.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace serialization {
+    
+// Плоский формат базы: заголовок, оглавление и секции из массивов записей
+// фиксированного размера, адресуемых смещениями. process_requests отображает
+// файл в память и использует таблицу маршрутов прямо из него, так что
+// несколько процессов разделяют одни и те же страницы
+namespace flat {
+    
+inline constexpr std::array<char, 8> MAGIC = {'T', 'C', 'F', 'L', 'A', 'T', '\0', '\0'};
+inline constexpr uint32_t VERSION = 1;
+inline constexpr uint64_t SECTION_ALIGNMENT = 64;
+    
+enum class SectionId : uint32_t {
+    NAMES,
+    STOPS,
+    BUSES,
+    BUS_STOPS,
+    DISTANCES,
+    STOP_INDEX,
+    BUS_INDEX,
+    RENDER_SETTINGS,
+    ROUTER_SETTINGS,
+    GRAPH_EDGES,
+    GRAPH_INCIDENCE,
+    ROUTES_TABLE,
+    // Пуста, если make_base не отрисовал карту заранее
+    RENDERED_MAP,
+    COUNT
+};
+    
+struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t section_count;
+};
+    
+struct SectionEntry {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+    
+// Строка в секции NAMES
+struct NameRef {
+    uint64_t offset;
+    uint64_t size;
+};
+    
+struct StopRecord {
+    NameRef name;
+    double lat;
+    double lng;
+};
+    
+struct BusRecord {
+    NameRef name;
+    // Диапазон номеров остановок в секции BUS_STOPS
+    uint64_t stops_offset;
+    uint64_t stops_count;
+    int32_t number_of_stops;
+    int32_t unique_stops;
+    int32_t route_length;
+    uint32_t is_circular;
+    double curvature;
+};
+    
+struct DistanceRecord {
+    uint32_t from;
+    uint32_t to;
+    uint64_t distance;
+};
+    
+struct EdgeRecord {
+    uint64_t from;
+    uint64_t to;
+    NameRef name;
+    uint32_t type;
+    int32_t span_count;
+    double weight;
+};
+    
+} // namespace flat
+    
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& file);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+    
+    const char* Data() const;
+    size_t Size() const;
+    
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+    
+bool IsFlatBase(const std::string& file);
+    
+class FlatSerializer {
+public:
+    explicit FlatSerializer(tcat::TransportCatalogue& catalogue, std::shared_ptr<router::TransportRouter> tr, map_r::MapRenderer& map_renderer);
+    
+    // Запись базы идёт стадиями, как у Serializer; файл пишет WriteEncodedSections
+    void EncodeCatalogueSections();
+    // Строит маршрутизатор, если он ещё не построен: база хранит граф с таблицей маршрутов.
+    // Имена рёбер берутся из секции имён, поэтому стадия идёт после EncodeCatalogueSections
+    void EncodeRouterSections();
+    // Секция есть, только если карта уже отрисована
+    void EncodeRenderedMapSection();
+    void WriteEncodedSections(const std::string& file);
+    
+    // Возвращает nullptr, если маршрутизатор не запрошен
+    std::shared_ptr<router::TransportRouter> DeserializeFromFile(const std::string& file, BaseParts parts = {});
+    
+private:
+    tcat::TransportCatalogue& tc_;
+    std::shared_ptr<router::TransportRouter> tr_ptr_;
+    map_r::MapRenderer& mr_;
+    // Закодированные секции по номерам SectionId; каждая стадия пишет только свои
+    std::array<std::string, static_cast<size_t>(flat::SectionId::COUNT)> sections_;
+    // Имена в секции NAMES, каждое — один раз
+    std::unordered_map<std::string_view, flat::NameRef> name_refs_;
+    
+    std::string& Section(flat::SectionId id);
+    flat::NameRef AddName(std::string_view name);
+};
+    
+} // namespace serialization
@@ -1,17 +1,70 @@
 #define _USE_MATH_DEFINES
 #include "geo.h"
 
+#include <algorithm>
 #include <cmath>
 
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 namespace geo {
+    
+namespace {
+const double dr = M_PI / 180.;
+const auto earth_r = 6371000;
+    
+// cos центрального угла между точками a[i] и b[i], i < count.
+// Для пары точек это скалярное произведение их единичных векторов:
+// sin(lat1)sin(lat2) + cos(lat1)cos(lat2)(cos(lng1)cos(lng2) + sin(lng1)sin(lng2))
+void ComputeCentralAngleCos(const double* sin_lat_a, const double* cos_lat_a,
+                            const double* sin_lng_a, const double* cos_lng_a,
+                            const double* sin_lat_b, const double* cos_lat_b,
+                            const double* sin_lng_b, const double* cos_lng_b,
+                            double* result, size_t count) {
+    size_t i = 0;
+#if defined(__AVX__)
+    for (; i + 4 <= count; i += 4) {
+        const __m256d cos_dlng = _mm256_add_pd(
+            _mm256_mul_pd(_mm256_loadu_pd(cos_lng_a + i), _mm256_loadu_pd(cos_lng_b + i)),
+            _mm256_mul_pd(_mm256_loadu_pd(sin_lng_a + i), _mm256_loadu_pd(sin_lng_b + i)));
+        const __m256d cos_part = _mm256_mul_pd(
+            _mm256_mul_pd(_mm256_loadu_pd(cos_lat_a + i), _mm256_loadu_pd(cos_lat_b + i)), cos_dlng);
+        const __m256d sin_part = _mm256_mul_pd(_mm256_loadu_pd(sin_lat_a + i), _mm256_loadu_pd(sin_lat_b + i));
+        _mm256_storeu_pd(result + i, _mm256_add_pd(sin_part, cos_part));
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= count; i += 2) {
+        const __m128d cos_dlng = _mm_add_pd(
+            _mm_mul_pd(_mm_loadu_pd(cos_lng_a + i), _mm_loadu_pd(cos_lng_b + i)),
+            _mm_mul_pd(_mm_loadu_pd(sin_lng_a + i), _mm_loadu_pd(sin_lng_b + i)));
+        const __m128d cos_part = _mm_mul_pd(
+            _mm_mul_pd(_mm_loadu_pd(cos_lat_a + i), _mm_loadu_pd(cos_lat_b + i)), cos_dlng);
+        const __m128d sin_part = _mm_mul_pd(_mm_loadu_pd(sin_lat_a + i), _mm_loadu_pd(sin_lat_b + i));
+        _mm_storeu_pd(result + i, _mm_add_pd(sin_part, cos_part));
+    }
+#endif
+    for (; i < count; ++i) {
+        const double cos_dlng = cos_lng_a[i] * cos_lng_b[i] + sin_lng_a[i] * sin_lng_b[i];
+        result[i] = sin_lat_a[i] * sin_lat_b[i] + cos_lat_a[i] * cos_lat_b[i] * cos_dlng;
+    }
+}
+}
+
+CompactCoordinates ToCompact(Coordinates coords) {
+    return {static_cast<int32_t>(std::lround(coords.lat * COMPACT_COORDINATES_SCALE)),
+            static_cast<int32_t>(std::lround(coords.lng * COMPACT_COORDINATES_SCALE))};
+}
+    
+Coordinates FromCompact(CompactCoordinates coords) {
+    return {coords.lat / COMPACT_COORDINATES_SCALE, coords.lng / COMPACT_COORDINATES_SCALE};
+}
 
 double ComputeDistance(Coordinates from, Coordinates to) {
     using namespace std;
     if (from == to) {
         return 0;
     }
-    static const double dr = M_PI / 180.;
-    static const auto earth_r = 6371000;
     return acos(sin(from.lat * dr) * sin(to.lat * dr)
                 + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr))
         * earth_r;
@@ -23,4 +76,76 @@ size_t CoordinatesHasher::operator()(const Coordinates& coords) const {
     return lat_hash * 37 + lng_hash;
 }
     
-}
\ No newline at end of file
+size_t SphericalPoints::Add(Coordinates coords) {
+    lat_.push_back(coords.lat);
+    lng_.push_back(coords.lng);
+    sin_lat_.push_back(std::sin(coords.lat * dr));
+    cos_lat_.push_back(std::cos(coords.lat * dr));
+    sin_lng_.push_back(std::sin(coords.lng * dr));
+    cos_lng_.push_back(std::cos(coords.lng * dr));
+    return lat_.size() - 1;
+}
+    
+void SphericalPoints::Reserve(size_t count) {
+    for (auto* column : {&lat_, &lng_, &sin_lat_, &cos_lat_, &sin_lng_, &cos_lng_}) {
+        column->reserve(count);
+    }
+}
+    
+size_t SphericalPoints::Size() const {
+    return lat_.size();
+}
+    
+Coordinates SphericalPoints::Get(size_t index) const {
+    return {lat_[index], lng_[index]};
+}
+    
+void ComputeSegmentDistances(const SphericalPoints& points, const std::vector<size_t>& route,
+                             std::vector<double>& distances) {
+    distances.clear();
+    if (route.size() < 2) {
+        return;
+    }
+    const size_t segments = route.size() - 1;
+    
+    // Собираем значения для остановок маршрута в непрерывные столбцы:
+    // начала отрезков — элементы [0, segments), концы — [1, segments + 1).
+    // Буфер живёт между вызовами и растёт только до самого длинного маршрута
+    thread_local std::vector<double> gathered;
+    gathered.resize(route.size() * 4);
+    double* sin_lat = gathered.data();
+    double* cos_lat = sin_lat + route.size();
+    double* sin_lng = cos_lat + route.size();
+    double* cos_lng = sin_lng + route.size();
+    for (size_t i = 0; i < route.size(); ++i) {
+        sin_lat[i] = points.SinLat()[route[i]];
+        cos_lat[i] = points.CosLat()[route[i]];
+        sin_lng[i] = points.SinLng()[route[i]];
+        cos_lng[i] = points.CosLng()[route[i]];
+    }
+    
+    distances.resize(segments);
+    ComputeCentralAngleCos(sin_lat, cos_lat, sin_lng, cos_lng,
+                           sin_lat + 1, cos_lat + 1, sin_lng + 1, cos_lng + 1,
+                           distances.data(), segments);
+    
+    for (size_t i = 0; i < segments; ++i) {
+        if (points.Get(route[i]) == points.Get(route[i + 1])) {
+            distances[i] = 0;
+        } else {
+            distances[i] = std::acos(std::clamp(distances[i], -1.0, 1.0)) * earth_r;
+        }
+    }
+}
+    
+double ComputeRouteDistance(const SphericalPoints& points, const std::vector<size_t>& route) {
+    thread_local std::vector<double> distances;
+    ComputeSegmentDistances(points, route, distances);
+    double result = 0;
+    for (double distance : distances) {
+        result += distance;
+    }
+    return result;
+}
+    
+}
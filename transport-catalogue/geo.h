@@ -1,5 +1,8 @@
 #pragma once
 #include <functional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
 
 namespace geo {
 
@@ -14,6 +17,23 @@ struct Coordinates {
     }
 };
 
+// Координаты с фиксированной точкой — в миллионных долях градуса
+struct CompactCoordinates {
+    int32_t lat = 0;
+    int32_t lng = 0;
+    bool operator==(const CompactCoordinates& other) const {
+        return lat == other.lat && lng == other.lng;
+    }
+    bool operator!=(const CompactCoordinates& other) const {
+        return !(*this == other);
+    }
+};
+    
+inline constexpr double COMPACT_COORDINATES_SCALE = 1e6;
+
+CompactCoordinates ToCompact(Coordinates coords);
+Coordinates FromCompact(CompactCoordinates coords);
+
 double ComputeDistance(Coordinates from, Coordinates to);
     
 struct CoordinatesHasher {
@@ -21,5 +41,76 @@ struct CoordinatesHasher {
 private:
     std::hash<double> d_hasher_;
 };
+    
+struct CompactCoordinatesHasher {
+    size_t operator()(const CompactCoordinates& coords) const {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(coords.lat)) << 32)
+            | static_cast<uint32_t>(coords.lng);
+    }
+};
+    
+// Тип, в котором координаты остановок хранятся в каталоге и в базе.
+// В double они переводятся только при проецировании и расчёте расстояний
+#ifdef TC_COMPACT_COORDINATES
+using StoredCoordinates = CompactCoordinates;
+using StoredCoordinatesHasher = CompactCoordinatesHasher;
+
+inline StoredCoordinates ToStored(Coordinates coords) {
+    return ToCompact(coords);
+}
+inline StoredCoordinates ToStored(CompactCoordinates coords) {
+    return coords;
+}
+#else
+using StoredCoordinates = Coordinates;
+using StoredCoordinatesHasher = CoordinatesHasher;
+
+inline StoredCoordinates ToStored(Coordinates coords) {
+    return coords;
+}
+inline StoredCoordinates ToStored(CompactCoordinates coords) {
+    return FromCompact(coords);
+}
+#endif
+    
+inline Coordinates ToCoordinates(Coordinates coords) {
+    return coords;
+}
+inline Coordinates ToCoordinates(CompactCoordinates coords) {
+    return FromCompact(coords);
+}
+    
+// Точки на сфере в виде структуры массивов: кроме самих координат
+// хранит заранее вычисленные синусы и косинусы широты и долготы
+class SphericalPoints {
+public:
+    size_t Add(Coordinates coords);
+    void Reserve(size_t count);
+    size_t Size() const;
+    Coordinates Get(size_t index) const;
+    
+    const std::vector<double>& Lat() const { return lat_; }
+    const std::vector<double>& Lng() const { return lng_; }
+    const std::vector<double>& SinLat() const { return sin_lat_; }
+    const std::vector<double>& CosLat() const { return cos_lat_; }
+    const std::vector<double>& SinLng() const { return sin_lng_; }
+    const std::vector<double>& CosLng() const { return cos_lng_; }
+    
+private:
+    std::vector<double> lat_;
+    std::vector<double> lng_;
+    std::vector<double> sin_lat_;
+    std::vector<double> cos_lat_;
+    std::vector<double> sin_lng_;
+    std::vector<double> cos_lng_;
+};
+    
+// Записывает в distances длины всех отрезков route[i] -> route[i + 1],
+// где route — индексы точек в points. Результат совпадает с ComputeDistance
+void ComputeSegmentDistances(const SphericalPoints& points, const std::vector<size_t>& route,
+                             std::vector<double>& distances);
+    
+// Суммарная длина ломаной route по поверхности Земли
+double ComputeRouteDistance(const SphericalPoints& points, const std::vector<size_t>& route);
 
-}
\ No newline at end of file
+}
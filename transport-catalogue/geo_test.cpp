@@ -0,0 +1,102 @@
+#include "geo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// Формулы расходятся только в округлении косинуса, а acos усиливает его у ±1:
+// там ошибка в угле порядка sqrt(eps), то есть доли миллиметра на поверхности Земли
+constexpr double RELATIVE_TOLERANCE = 1e-9;
+constexpr double ABSOLUTE_TOLERANCE = 1e-3;
+
+int failures = 0;
+
+// Сравнения записаны через <=, чтобы NaN с любой стороны тоже был ошибкой
+
+void CheckRoute(const geo::SphericalPoints& points, const vector<size_t>& route, const string& name) {
+    vector<double> distances;
+    geo::ComputeSegmentDistances(points, route, distances);
+    const size_t segments = route.empty() ? 0 : route.size() - 1;
+    if (distances.size() != segments) {
+        cerr << name << ": " << distances.size() << " distances for " << segments << " segments\n";
+        ++failures;
+        return;
+    }
+    double expected_total = 0;
+    for (size_t i = 0; i < segments; ++i) {
+        const double expected = geo::ComputeDistance(points.Get(route[i]), points.Get(route[i + 1]));
+        expected_total += expected;
+        if (!(abs(distances[i] - expected) <= max(expected * RELATIVE_TOLERANCE, ABSOLUTE_TOLERANCE))) {
+            cerr.precision(17);
+            cerr << name << ", segment " << i << ": " << distances[i] << " instead of " << expected << '\n';
+            ++failures;
+        }
+    }
+    const double total = geo::ComputeRouteDistance(points, route);
+    if (!(abs(total - expected_total) <= max(expected_total * RELATIVE_TOLERANCE, ABSOLUTE_TOLERANCE * segments))) {
+        cerr.precision(17);
+        cerr << name << ": route distance " << total << " instead of " << expected_total << '\n';
+        ++failures;
+    }
+}
+
+// Длины подобраны так, чтобы у векторной части был и пустой, и непустой хвост
+// при двух (SSE2) и четырёх (AVX) отрезках за шаг
+void CheckRandomRoutes(geo::SphericalPoints& points) {
+    mt19937 generator(42);
+    uniform_real_distribution<double> lat(-90, 90);
+    uniform_real_distribution<double> lng(-180, 180);
+    const size_t first = points.Size();
+    for (int i = 0; i < 1000; ++i) {
+        points.Add({lat(generator), lng(generator)});
+    }
+    uniform_int_distribution<size_t> point(first, points.Size() - 1);
+    for (size_t length : {0, 1, 2, 3, 4, 5, 6, 8, 9, 17, 64, 101, 1000}) {
+        for (int attempt = 0; attempt < 20; ++attempt) {
+            vector<size_t> route(length);
+            generate(route.begin(), route.end(), [&] { return point(generator); });
+            CheckRoute(points, route, "random route of " + to_string(length));
+        }
+    }
+}
+
+// Совпадающие точки дают ровно ноль, а почти противоположные — половину окружности
+void CheckSpecialPoints(geo::SphericalPoints& points) {
+    const size_t moscow = points.Add({55.751244, 37.618423});
+    const size_t moscow_again = points.Add({55.751244, 37.618423});
+    const size_t antipode = points.Add({-55.751244, 37.618423 - 180});
+    const size_t near_antipode = points.Add({-55.751243, 37.618423 - 180 + 1e-6});
+    const size_t north_pole = points.Add({90, 0});
+    const size_t south_pole = points.Add({-90, 0});
+    const size_t near_north_pole = points.Add({89.999999, 120});
+
+    const vector<size_t> same{moscow, moscow_again, moscow, moscow_again, moscow, moscow};
+    vector<double> distances;
+    geo::ComputeSegmentDistances(points, same, distances);
+    if (any_of(distances.begin(), distances.end(), [](double distance) { return distance != 0; })) {
+        cerr << "identical points: nonzero distance\n";
+        ++failures;
+    }
+    CheckRoute(points, same, "identical points");
+    CheckRoute(points, {moscow, antipode, moscow, near_antipode, moscow_again, antipode}, "antipodes");
+    CheckRoute(points, {north_pole, south_pole, near_north_pole, north_pole, south_pole}, "poles");
+}
+} // namespace
+
+int main() {
+    geo::SphericalPoints points;
+    CheckSpecialPoints(points);
+    CheckRandomRoutes(points);
+    if (failures > 0) {
+        cerr << failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    cout << "geo_test OK\n";
+}
@@ -3,6 +3,7 @@
 #include "ranges.h"
 
 #include <cstdlib>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -43,8 +44,8 @@ public:
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
     
-    const std::vector<Edge<Weight>> GetAllEdges() const;
-    const std::vector<std::vector<size_t>> GetAllIncidenceLists() const;
+    const std::vector<Edge<Weight>>& GetAllEdges() const;
+    const std::vector<IncidenceList>& GetAllIncidenceLists() const;
 
 private:
     std::vector<Edge<Weight>> edges_;
@@ -90,12 +91,12 @@ DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
 }
 
 template <typename Weight>
-const std::vector<Edge<Weight>> DirectedWeightedGraph<Weight>::GetAllEdges() const {
+const std::vector<Edge<Weight>>& DirectedWeightedGraph<Weight>::GetAllEdges() const {
     return edges_;
 }
 
 template <typename Weight>
-const std::vector<std::vector<size_t>> DirectedWeightedGraph<Weight>::GetAllIncidenceLists() const {
+const std::vector<typename DirectedWeightedGraph<Weight>::IncidenceList>& DirectedWeightedGraph<Weight>::GetAllIncidenceLists() const {
     return incidence_lists_;
 }
 }  // namespace graph
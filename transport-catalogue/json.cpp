@@ -1,6 +1,15 @@
 #include "json.h"
-
-#include <iterator>
+#include "json_writer.h"
+#include "number_format.h"
+#include "text_scan.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string_view>
+#include <tuple>
 
 using namespace std;
 
@@ -9,341 +18,532 @@ namespace json {
 namespace {
 using namespace std::literals;
 
-Node LoadNode(std::istream& input);
-Node LoadString(std::istream& input);
+// Разбирает JSON из непрерывного буфера, не копируя его, или из потока, дочитывая его
+// по частям, и сообщает о значениях обработчику
+class Parser {
+public:
+    explicit Parser(std::string_view text)
+        : pos_(text.data())
+        , end_(text.data() + text.size()) {
+    }
+    
+    explicit Parser(std::istream& input)
+        : input_(input.rdbuf()) {
+    }
 
-std::string LoadLiteral(std::istream& input) {
-    std::string s;
-    while (std::isalpha(input.peek())) {
-        s.push_back(static_cast<char>(input.get()));
+    void ParseValue(Handler& handler) {
+        if (!SkipSpaces()) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        const char c = *pos_++;
+        switch (c) {
+            case '[':
+                ParseArray(handler);
+                break;
+            case '{':
+                ParseDict(handler);
+                break;
+            case '"':
+                handler.String(ParseString());
+                break;
+            case 't':
+                // Встретив t или f, переходим к попытке парсинга литералов true либо false
+                [[fallthrough]];
+            case 'f':
+                --pos_;
+                ParseBool(handler);
+                break;
+            case 'n':
+                --pos_;
+                ParseNull(handler);
+                break;
+            default:
+                --pos_;
+                ParseNumber(handler);
+        }
     }
-    return s;
-}
 
-Node LoadArray(std::istream& input) {
-    std::vector<Node> result;
+    // После значения остались только пробельные символы
+    bool AtEnd() {
+        return !SkipSpaces();
+    }
 
-    for (char c; input >> c && c != ']';) {
-        if (c != ',') {
-            input.putback(c);
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    
+    const char* pos_ = nullptr;
+    const char* end_ = nullptr;
+    std::streambuf* input_ = nullptr;
+    std::string buffer_;
+    // Начало разбираемой лексемы; при дочитывании она переносится в начало буфера
+    const char* token_ = nullptr;
+    // Строки с экранированием собираются здесь, остальные передаются прямо из буфера
+    std::string unescaped_;
+    
+    bool HasMore() {
+        return pos_ != end_ || Refill();
+    }
+    
+    // Дочитывает из потока то, что уже доступно, чтобы не ждать следующих данных
+    // при разборе по мере поступления
+    bool Refill() {
+        if (input_ == nullptr || input_->sgetc() == std::char_traits<char>::eof()) {
+            return false;
         }
-        result.push_back(LoadNode(input));
+        const size_t kept = token_ != nullptr ? static_cast<size_t>(end_ - token_) : 0;
+        if (kept > 0) {
+            std::memmove(buffer_.data(), token_, kept);
+        }
+        const std::streamsize available = input_->in_avail();
+        const size_t chunk = available > 0 ? std::min(static_cast<size_t>(available), CHUNK_SIZE) : CHUNK_SIZE;
+        if (buffer_.size() < kept + chunk) {
+            buffer_.resize(kept + chunk);
+        }
+        const std::streamsize read = input_->sgetn(buffer_.data() + kept, static_cast<std::streamsize>(chunk));
+        if (token_ != nullptr) {
+            token_ = buffer_.data();
+        }
+        pos_ = buffer_.data() + kept;
+        end_ = pos_ + read;
+        return read > 0;
     }
-    if (!input) {
-        throw ParsingError("Array parsing error"s);
+
+    // Пропускает пробельные символы; false, если буфер закончился
+    bool SkipSpaces() {
+        do {
+            while (pos_ != end_ && (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t'
+                                    || *pos_ == '\v' || *pos_ == '\f')) {
+                ++pos_;
+            }
+        } while (pos_ == end_ && Refill());
+        return pos_ != end_;
     }
-    return Node(std::move(result));
-}
 
-Node LoadDict(std::istream& input) {
-    Dict dict;
+    bool IsDigit() {
+        return HasMore() && *pos_ >= '0' && *pos_ <= '9';
+    }
 
-    for (char c; input >> c && c != '}';) {
-        if (c == '"') {
-            std::string key = LoadString(input).AsString();
-            if (input >> c && c == ':') {
-                if (dict.find(key) != dict.end()) {
-                    throw ParsingError("Duplicate key '"s + key + "' have been found");
-                }
-                dict.emplace(std::move(key), LoadNode(input));
-            } else {
-                throw ParsingError(": is expected but '"s + c + "' has been found"s);
+    std::string_view LoadLiteral() {
+        token_ = pos_;
+        while (HasMore() && std::isalpha(static_cast<unsigned char>(*pos_))) {
+            ++pos_;
+        }
+        const std::string_view literal(token_, static_cast<size_t>(pos_ - token_));
+        token_ = nullptr;
+        return literal;
+    }
+
+    void ParseArray(Handler& handler) {
+        handler.StartArray();
+        while (true) {
+            if (!SkipSpaces()) {
+                throw ParsingError("Array parsing error"s);
             }
-        } else if (c != ',') {
-            throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            const char c = *pos_++;
+            if (c == ']') {
+                break;
+            }
+            if (c != ',') {
+                --pos_;
+            }
+            ParseValue(handler);
         }
+        handler.EndArray();
     }
-    if (!input) {
-        throw ParsingError("Dictionary parsing error"s);
+
+    void ParseDict(Handler& handler) {
+        handler.StartDict();
+        while (true) {
+            if (!SkipSpaces()) {
+                throw ParsingError("Dictionary parsing error"s);
+            }
+            char c = *pos_++;
+            if (c == '}') {
+                break;
+            }
+            if (c == '"') {
+                std::string_view key = ParseString();
+                // Пока ищется двоеточие, буфер может быть дочитан; ключ из буфера переносится вместе с ним
+                const bool in_buffer = key.data() != unescaped_.data();
+                if (in_buffer) {
+                    token_ = key.data();
+                }
+                const bool has_colon = SkipSpaces() && (c = *pos_++) == ':';
+                if (in_buffer) {
+                    key = {token_, key.size()};
+                    token_ = nullptr;
+                }
+                if (has_colon) {
+                    handler.Key(key);
+                    ParseValue(handler);
+                } else {
+                    throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                }
+            } else if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+        handler.EndDict();
     }
-    return Node(std::move(dict));
-}
 
-Node LoadString(std::istream& input) {
-    auto it = std::istreambuf_iterator<char>(input);
-    auto end = std::istreambuf_iterator<char>();
-    std::string s;
-    while (true) {
-        if (it == end) {
-            throw ParsingError("String parsing error");
+    // Строка действительна до следующего чтения из буфера
+    std::string_view ParseString() {
+        token_ = pos_;
+        // Участки без кавычек, экранирования и переводов строк не копируются
+        do {
+            pos_ = scan::FindJsonSpecial(pos_, end_);
+        } while (pos_ == end_ && Refill());
+        if (pos_ != end_ && *pos_ == '"') {
+            const std::string_view value(token_, static_cast<size_t>(pos_++ - token_));
+            token_ = nullptr;
+            return value;
         }
-        const char ch = *it;
-        if (ch == '"') {
-            ++it;
-            break;
-        } else if (ch == '\\') {
-            ++it;
-            if (it == end) {
+
+        unescaped_.assign(token_, pos_);
+        token_ = nullptr;
+        while (true) {
+            if (!HasMore()) {
                 throw ParsingError("String parsing error");
             }
-            const char escaped_char = *(it);
-            switch (escaped_char) {
-                case 'n':
-                    s.push_back('\n');
-                    break;
-                case 't':
-                    s.push_back('\t');
-                    break;
-                case 'r':
-                    s.push_back('\r');
-                    break;
-                case '"':
-                    s.push_back('"');
-                    break;
-                case '\\':
-                    s.push_back('\\');
-                    break;
-                default:
-                    throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+            // Участок до следующего особого символа копируется целиком
+            const char* special = scan::FindJsonSpecial(pos_, end_);
+            unescaped_.append(pos_, special);
+            pos_ = special;
+            if (pos_ == end_) {
+                continue;
+            }
+            const char ch = *pos_++;
+            if (ch == '"') {
+                break;
+            } else if (ch == '\\') {
+                if (!HasMore()) {
+                    throw ParsingError("String parsing error");
+                }
+                const char escaped_char = *pos_++;
+                switch (escaped_char) {
+                    case 'n':
+                        unescaped_.push_back('\n');
+                        break;
+                    case 't':
+                        unescaped_.push_back('\t');
+                        break;
+                    case 'r':
+                        unescaped_.push_back('\r');
+                        break;
+                    case '"':
+                        unescaped_.push_back('"');
+                        break;
+                    case '\\':
+                        unescaped_.push_back('\\');
+                        break;
+                    default:
+                        throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+                }
+            } else {
+                throw ParsingError("Unexpected end of line"s);
             }
-        } else if (ch == '\n' || ch == '\r') {
-            throw ParsingError("Unexpected end of line"s);
-        } else {
-            s.push_back(ch);
         }
-        ++it;
+        return unescaped_;
     }
 
-    return Node(std::move(s));
-}
+    void ParseBool(Handler& handler) {
+        const auto s = LoadLiteral();
+        if (s == "true"sv) {
+            handler.Bool(true);
+        } else if (s == "false"sv) {
+            handler.Bool(false);
+        } else {
+            throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
+        }
+    }
 
-Node LoadBool(std::istream& input) {
-    const auto s = LoadLiteral(input);
-    if (s == "true"sv) {
-        return Node{true};
-    } else if (s == "false"sv) {
-        return Node{false};
-    } else {
-        throw ParsingError("Failed to parse '"s + s + "' as bool"s);
+    void ParseNull(Handler& handler) {
+        if (auto literal = LoadLiteral(); literal == "null"sv) {
+            handler.Null();
+        } else {
+            throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
+        }
     }
-}
 
-Node LoadNull(std::istream& input) {
-    if (auto literal = LoadLiteral(input); literal == "null"sv) {
-        return Node{nullptr};
-    } else {
-        throw ParsingError("Failed to parse '"s + literal + "' as null"s);
+    // Пропускает одну или более цифр
+    void SkipDigits() {
+        if (!IsDigit()) {
+            throw ParsingError("A digit is expected"s);
+        }
+        do {
+            while (pos_ != end_ && *pos_ >= '0' && *pos_ <= '9') {
+                ++pos_;
+            }
+        } while (pos_ == end_ && Refill());
     }
-}
 
-Node LoadNumber(std::istream& input) {
-    std::string parsed_num;
+    void ParseNumber(Handler& handler) {
+        token_ = pos_;
 
-    // Считывает в parsed_num очередной символ из input
-    auto read_char = [&parsed_num, &input] {
-        parsed_num += static_cast<char>(input.get());
-        if (!input) {
-            throw ParsingError("Failed to read number from stream"s);
+        if (HasMore() && *pos_ == '-') {
+            ++pos_;
+        }
+        // Парсим целую часть числа
+        if (HasMore() && *pos_ == '0') {
+            ++pos_;
+            // После 0 в JSON не могут идти другие цифры
+        } else {
+            SkipDigits();
         }
-    };
 
-    // Считывает одну или более цифр в parsed_num из input
-    auto read_digits = [&input, read_char] {
-        if (!std::isdigit(input.peek())) {
-            throw ParsingError("A digit is expected"s);
+        bool is_int = true;
+        // Парсим дробную часть числа
+        if (HasMore() && *pos_ == '.') {
+            ++pos_;
+            SkipDigits();
+            is_int = false;
         }
-        while (std::isdigit(input.peek())) {
-            read_char();
+
+        // Парсим экспоненциальную часть числа
+        if (HasMore() && (*pos_ == 'e' || *pos_ == 'E')) {
+            ++pos_;
+            if (HasMore() && (*pos_ == '+' || *pos_ == '-')) {
+                ++pos_;
+            }
+            SkipDigits();
+            is_int = false;
         }
-    };
 
-    if (input.peek() == '-') {
-        read_char();
-    }
-    // Парсим целую часть числа
-    if (input.peek() == '0') {
-        read_char();
-        // После 0 в JSON не могут идти другие цифры
-    } else {
-        read_digits();
+        if (is_int) {
+            // Сначала пробуем преобразовать число в int; при переполнении
+            // код ниже преобразует его в double
+            int value = 0;
+            if (num::Parse({token_, static_cast<size_t>(pos_ - token_)}, value)) {
+                token_ = nullptr;
+                handler.Int(value);
+                return;
+            }
+        }
+        double value = 0.0;
+        if (!num::Parse({token_, static_cast<size_t>(pos_ - token_)}, value)) {
+            throw ParsingError("Failed to convert "s + std::string(token_, pos_) + " to number"s);
+        }
+        token_ = nullptr;
+        handler.Double(value);
     }
+};
 
-    bool is_int = true;
-    // Парсим дробную часть числа
-    if (input.peek() == '.') {
-        read_char();
-        read_digits();
-        is_int = false;
+// Строит документ по событиям разбора в арене resource. Элементы открытых массивов и словарей
+// копятся во временных буферах и при закрытии переносятся в контейнер точного размера
+class DocumentBuilder final : public Handler {
+public:
+    explicit DocumentBuilder(std::pmr::memory_resource* resource)
+        : resource_(resource)
+        , key_(resource) {
     }
-
-    // Парсим экспоненциальную часть числа
-    if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-        read_char();
-        if (ch = input.peek(); ch == '+' || ch == '-') {
-            read_char();
-        }
-        read_digits();
-        is_int = false;
+    
+    Node Extract() {
+        return std::move(root_);
     }
 
-    try {
-        if (is_int) {
-            // Сначала пробуем преобразовать строку в int
-            try {
-                return std::stoi(parsed_num);
-            } catch (...) {
-                // В случае неудачи, например, при переполнении
-                // код ниже попробует преобразовать строку в double
-            }
+    void Null() override {
+        AddValue(nullptr);
+    }
+    void Bool(bool value) override {
+        AddValue(value);
+    }
+    void Int(int value) override {
+        AddValue(value);
+    }
+    void Double(double value) override {
+        AddValue(value);
+    }
+    void String(std::string_view value) override {
+        AddValue(json::String(value, resource_));
+    }
+    void Key(std::string_view key) override {
+        key_.assign(key);
+    }
+    void StartDict() override {
+        open_.push_back({false, dict_items_.size(), std::move(key_)});
+    }
+    void EndDict() override {
+        const auto first = dict_items_.begin() + open_.back().first_item;
+        Dict dict(resource_);
+        dict.Reserve(dict_items_.end() - first);
+        for (auto it = first; it != dict_items_.end(); ++it) {
+            dict.AppendUnsorted(std::move(*it));
         }
-        return std::stod(parsed_num);
-    } catch (...) {
-        throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
-    }
-}
-
-Node LoadNode(std::istream& input) {
-    char c;
-    if (!(input >> c)) {
-        throw ParsingError("Unexpected EOF"s);
-    }
-    switch (c) {
-        case '[':
-            return LoadArray(input);
-        case '{':
-            return LoadDict(input);
-        case '"':
-            return LoadString(input);
-        case 't':
-            // Атрибут [[fallthrough]] (провалиться) ничего не делает, и является
-            // подсказкой компилятору и человеку, что здесь программист явно задумывал
-            // разрешить переход к инструкции следующей ветки case, а не случайно забыл
-            // написать break, return или throw.
-            // В данном случае, встретив t или f, переходим к попытке парсинга
-            // литералов true либо false
-            [[fallthrough]];
-        case 'f':
-            input.putback(c);
-            return LoadBool(input);
-        case 'n':
-            input.putback(c);
-            return LoadNull(input);
-        default:
-            input.putback(c);
-            return LoadNumber(input);
-    }
-}
-
-struct PrintContext {
-    std::ostream& out;
-    int indent_step = 4;
-    int indent = 0;
-
-    void PrintIndent() const {
-        for (int i = 0; i < indent; ++i) {
-            out.put(' ');
+        if (const auto duplicate = dict.SortKeys(); duplicate != dict.end()) {
+            throw ParsingError("Duplicate key '"s + std::string(duplicate->first) + "' have been found");
         }
+        dict_items_.erase(first, dict_items_.end());
+        Close(std::move(dict));
+    }
+    void StartArray() override {
+        open_.push_back({true, 0, std::move(key_)});
+        if (++array_depth_ > array_items_.size()) {
+            array_items_.emplace_back();
+        }
+    }
+    void EndArray() override {
+        std::vector<Node>& items = array_items_[array_depth_ - 1];
+        Array array(std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()), resource_);
+        items.clear();
+        --array_depth_;
+        Close(std::move(array));
     }
 
-    PrintContext Indented() const {
-        return {out, indent_step, indent_step + indent};
+private:
+    struct OpenContainer {
+        bool is_array;
+        size_t first_item;
+        // Ключ, под которым контейнер попадёт в родительский словарь
+        json::String key;
+    };
+    
+    std::pmr::memory_resource* resource_;
+    Node root_;
+    std::vector<OpenContainer> open_;
+    // Буферы массивов по уровням вложенности; они не освобождаются, а переиспользуются
+    std::vector<std::vector<Node>> array_items_;
+    size_t array_depth_ = 0;
+    std::vector<Dict::value_type> dict_items_;
+    json::String key_;
+
+    void AddValue(Node value) {
+        if (open_.empty()) {
+            root_ = std::move(value);
+        } else if (open_.back().is_array) {
+            array_items_[array_depth_ - 1].push_back(std::move(value));
+        } else {
+            dict_items_.emplace_back(std::move(key_), std::move(value));
+        }
+    }
+    
+    void Close(Node container) {
+        key_ = std::move(open_.back().key);
+        open_.pop_back();
+        AddValue(std::move(container));
     }
 };
 
-void PrintNode(const Node& value, const PrintContext& ctx);
-
-template <typename Value>
-void PrintValue(const Value& value, const PrintContext& ctx) {
-    ctx.out << value;
+// Document из Load владеет ареной через shared_ptr на свой корень
+Document BuildDocument(const function<void(Handler&)>& parse) {
+    auto arena = make_shared<pmr::monotonic_buffer_resource>();
+    DocumentBuilder builder(arena.get());
+    parse(builder);
+    // Корень тоже размещается в арене; деструкторы узлов не вызываются, память арены
+    // освобождается вместе с ней
+    void* place = arena->allocate(sizeof(Node), alignof(Node));
+    const Node* root = new (place) Node(builder.Extract());
+    return Document{shared_ptr<const Node>(arena, root)};
 }
 
-void PrintString(const std::string& value, std::ostream& out) {
-    out.put('"');
-    for (const char c : value) {
-        switch (c) {
-            case '\r':
-                out << "\\r"sv;
-                break;
-            case '\n':
-                out << "\\n"sv;
-                break;
-            case '"':
-                // Символы " и \ выводятся как \" или \\, соответственно
-                [[fallthrough]];
-            case '\\':
-                out.put('\\');
-                [[fallthrough]];
-            default:
-                out.put(c);
-                break;
-        }
-    }
-    out.put('"');
+}  // namespace
+    
+Dict::Dict(pmr::memory_resource* resource)
+    : items_(resource) {
 }
-
-template <>
-void PrintValue<std::string>(const std::string& value, const PrintContext& ctx) {
-    PrintString(value, ctx.out);
+    
+bool Dict::empty() const {
+    return items_.empty();
 }
-
-template <>
-void PrintValue<std::nullptr_t>(const std::nullptr_t&, const PrintContext& ctx) {
-    ctx.out << "null"sv;
+    
+size_t Dict::size() const {
+    return items_.size();
 }
-
-// В специализаци шаблона PrintValue для типа bool параметр value передаётся
-// по константной ссылке, как и в основном шаблоне.
-// В качестве альтернативы можно использовать перегрузку:
-// void PrintValue(bool value, const PrintContext& ctx);
-template <>
-void PrintValue<bool>(const bool& value, const PrintContext& ctx) {
-    ctx.out << (value ? "true"sv : "false"sv);
+    
+Dict::iterator Dict::begin() {
+    return items_.begin();
 }
-
-template <>
-void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
-    std::ostream& out = ctx.out;
-    out << "[\n"sv;
-    bool first = true;
-    auto inner_ctx = ctx.Indented();
-    for (const Node& node : nodes) {
-        if (first) {
-            first = false;
-        } else {
-            out << ",\n"sv;
-        }
-        inner_ctx.PrintIndent();
-        PrintNode(node, inner_ctx);
-    }
-    out.put('\n');
-    ctx.PrintIndent();
-    out.put(']');
-}
-
-template <>
-void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) {
-    std::ostream& out = ctx.out;
-    out << "{\n"sv;
-    bool first = true;
-    auto inner_ctx = ctx.Indented();
-    for (const auto& [key, node] : nodes) {
-        if (first) {
-            first = false;
-        } else {
-            out << ",\n"sv;
-        }
-        inner_ctx.PrintIndent();
-        PrintString(key, ctx.out);
-        out << ": "sv;
-        PrintNode(node, inner_ctx);
+    
+Dict::iterator Dict::end() {
+    return items_.end();
+}
+    
+Dict::const_iterator Dict::begin() const {
+    return items_.begin();
+}
+    
+Dict::const_iterator Dict::end() const {
+    return items_.end();
+}
+    
+Dict::iterator Dict::LowerBound(string_view key) {
+    return lower_bound(items_.begin(), items_.end(), key, [](const value_type& item, string_view key) {
+        return string_view(item.first) < key;
+    });
+}
+    
+Dict::const_iterator Dict::LowerBound(string_view key) const {
+    return lower_bound(items_.begin(), items_.end(), key, [](const value_type& item, string_view key) {
+        return string_view(item.first) < key;
+    });
+}
+    
+Dict::iterator Dict::find(string_view key) {
+    const auto it = LowerBound(key);
+    return it != items_.end() && it->first == key ? it : items_.end();
+}
+    
+Dict::const_iterator Dict::find(string_view key) const {
+    const auto it = LowerBound(key);
+    return it != items_.end() && it->first == key ? it : items_.end();
+}
+    
+size_t Dict::count(string_view key) const {
+    return find(key) != end() ? 1 : 0;
+}
+    
+Node& Dict::at(string_view key) {
+    const auto it = find(key);
+    if (it == items_.end()) {
+        throw out_of_range("No key '"s + string(key) + "' in dict"s);
     }
-    out.put('\n');
-    ctx.PrintIndent();
-    out.put('}');
+    return it->second;
 }
-
-void PrintNode(const Node& node, const PrintContext& ctx) {
-    std::visit(
-        [&ctx](const auto& value) {
-            PrintValue(value, ctx);
-        },
-        node.GetValue());
+    
+const Node& Dict::at(string_view key) const {
+    const auto it = find(key);
+    if (it == items_.end()) {
+        throw out_of_range("No key '"s + string(key) + "' in dict"s);
+    }
+    return it->second;
+}
+    
+Node& Dict::operator[](string_view key) {
+    return try_emplace(key).first->second;
+}
+    
+pair<Dict::iterator, bool> Dict::try_emplace(string_view key) {
+    const auto it = LowerBound(key);
+    if (it != items_.end() && it->first == key) {
+        return {it, false};
+    }
+    return {items_.emplace(it, piecewise_construct, forward_as_tuple(key), forward_as_tuple()), true};
+}
+    
+void Dict::Reserve(size_t size) {
+    items_.reserve(size);
+}
+    
+void Dict::AppendUnsorted(value_type&& item) {
+    items_.push_back(move(item));
+}
+    
+Dict::iterator Dict::SortKeys() {
+    sort(items_.begin(), items_.end(), [](const value_type& lhs, const value_type& rhs) {
+        return lhs.first < rhs.first;
+    });
+    return adjacent_find(items_.begin(), items_.end(), [](const value_type& lhs, const value_type& rhs) {
+        return lhs.first == rhs.first;
+    });
 }
-
-}  // namespace
 
 Node::Node(Value value) : variant(move(value)) {}
     
+Node::Node(string_view value) : variant(String(value)) {}
+    
+Node::Node(const string& value) : variant(String(value)) {}
+    
+Node::Node(const char* value) : variant(String(value)) {}
+    
 bool Node::IsInt() const {
     return holds_alternative<int>(*this);
 }
@@ -359,7 +559,7 @@ bool Node::IsBool() const {
     return holds_alternative<bool>(*this);
 }
 bool Node::IsString() const {
-    return holds_alternative<string>(*this);
+    return holds_alternative<String>(*this);
 }
 bool Node::IsNull() const {
     return holds_alternative<nullptr_t>(*this);
@@ -396,11 +596,11 @@ double Node::AsDouble() const {
     }
 }
     
-const string& Node::AsString() const {
+string_view Node::AsString() const {
     if (!IsString()) {
         throw logic_error("not a string"s);
     }
-    return get<string>(*this);
+    return get<String>(*this);
 }
     
 const Array& Node::AsArray() const {
@@ -440,19 +640,176 @@ const Node::Value& Node::GetValue() const {
 }
     
 Document::Document(Node root)
+    : root_(make_shared<const Node>(move(root))) {
+}
+    
+Document::Document(shared_ptr<const Node> root)
     : root_(move(root)) {
 }
 
 const Node& Document::GetRoot() const {
-    return root_;
+    return *root_;
+}
+    
+Document Load(std::string_view text) {
+    return BuildDocument([text](Handler& builder) {
+        Parser(text).ParseValue(builder);
+    });
 }
     
 Document Load(std::istream& input) {
-    return Document{LoadNode(input)};
+    return BuildDocument([&input](Handler& builder) {
+        Parser(input).ParseValue(builder);
+    });
+}
+    
+void Parse(std::string_view text, Handler& handler) {
+    Parser(text).ParseValue(handler);
+}
+    
+void Parse(std::istream& input, Handler& handler) {
+    Parser(input).ParseValue(handler);
+}
+    
+bool ParseWhole(std::string_view text, Handler& handler) {
+    Parser parser(text);
+    parser.ParseValue(handler);
+    return parser.AtEnd();
+}
+
+std::optional<RootArray> FindRootArray(std::string_view text, std::string_view key) {
+    const char* pos = text.data();
+    const char* const end = pos + text.size();
+    int depth = 0;
+    // Последняя строка корневого словаря; перед двоеточием это ключ
+    std::string_view last_string;
+    bool key_matches = false;
+    std::optional<RootArray> result;
+    const char* array_begin = nullptr;
+    const char* item_begin = nullptr;
+    const char* item_end = nullptr;
+    // Элемент-строка или контейнер уже закрыт: разбор массива, как и Parser, не требует
+    // запятых между элементами, и следующее значение начинает новый элемент
+    bool item_closed = false;
+    // Внутри искомого массива его элементы лежат на глубине 2
+    const auto in_items = [&] {
+        return array_begin != nullptr && depth == 2;
+    };
+    const auto finish_item = [&] {
+        if (item_begin == nullptr) {
+            return false;
+        }
+        result->items.emplace_back(item_begin, static_cast<size_t>(item_end - item_begin));
+        item_begin = nullptr;
+        return true;
+    };
+    const auto start_item = [&](const char* value_begin) {
+        if (item_closed) {
+            finish_item();
+        }
+        if (item_begin == nullptr) {
+            item_begin = value_begin;
+            item_closed = false;
+        }
+    };
+    
+    while (pos != end) {
+        if (depth > 2) {
+            // Внутри элемента важны только строки и скобки
+            pos = scan::FindJsonNesting(pos, end);
+            if (pos == end) {
+                break;
+            }
+        }
+        const char c = *pos;
+        if (c == '"') {
+            const char* const string_begin = pos++;
+            while (true) {
+                pos = scan::FindJsonSpecial(pos, end);
+                if (pos == end || (*pos == '\\' && end - pos < 2)) {
+                    return std::nullopt;
+                }
+                if (*pos == '"') {
+                    break;
+                }
+                pos += *pos == '\\' ? 2 : 1;
+            }
+            ++pos;
+            if (depth == 1) {
+                last_string = {string_begin + 1, static_cast<size_t>(pos - string_begin - 2)};
+            } else if (in_items()) {
+                start_item(string_begin);
+                item_closed = true;
+            }
+            item_end = pos;
+            continue;
+        }
+        switch (c) {
+            case ':':
+                if (depth == 1) {
+                    key_matches = last_string == key;
+                } else if (in_items()) {
+                    return std::nullopt;
+                }
+                break;
+            case '[':
+            case '{':
+                if (in_items()) {
+                    start_item(pos);
+                } else if (depth == 1 && c == '[' && key_matches) {
+                    if (result) {
+                        return std::nullopt;
+                    }
+                    result.emplace();
+                    array_begin = pos;
+                }
+                ++depth;
+                break;
+            case ']':
+            case '}':
+                if (--depth < 0) {
+                    return std::nullopt;
+                }
+                item_end = pos + 1;
+                item_closed = in_items();
+                if (array_begin != nullptr && depth == 1) {
+                    // Пустой элемент бывает только у пустого массива
+                    if (c != ']' || (!finish_item() && !result->items.empty())) {
+                        return std::nullopt;
+                    }
+                    result->array = {array_begin, static_cast<size_t>(pos + 1 - array_begin)};
+                    array_begin = nullptr;
+                }
+                break;
+            case ',':
+                if (in_items() && !finish_item()) {
+                    return std::nullopt;
+                }
+                item_closed = false;
+                break;
+            case ' ':
+            case '\n':
+            case '\r':
+            case '\t':
+                break;
+            default:
+                if (in_items()) {
+                    start_item(pos);
+                }
+                item_end = pos + 1;
+        }
+        ++pos;
+    }
+    if (depth != 0) {
+        return std::nullopt;
+    }
+    return result;
 }
 
 void Print(const Document& doc, std::ostream& output) {
-    PrintNode(doc.GetRoot(), PrintContext{output});
+    std::string buffer;
+    Writer(buffer).Value(doc.GetRoot());
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 }
 
 }  // namespace json
\ No newline at end of file
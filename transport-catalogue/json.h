@@ -1,30 +1,79 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include <variant>
 
 namespace json {
 
 class Node;
-using Dict = std::map<std::string, Node>;
-using Array = std::vector<Node>;
+// Строки, массивы и словари берут память у распределителя, с которым созданы. Документ
+// из Load размещает в одной арене всё дерево и освобождает его целиком, не обходя узлы
+using String = std::pmr::string;
+using Array = std::pmr::vector<Node>;
 
 class ParsingError : public std::runtime_error {
 public:
     using runtime_error::runtime_error;
 };
 
+// Словарь в виде упорядоченного по ключам вектора: узлы лежат подряд, поиск двоичный
+class Dict {
+public:
+    using value_type = std::pair<String, Node>;
+    using iterator = std::pmr::vector<value_type>::iterator;
+    using const_iterator = std::pmr::vector<value_type>::const_iterator;
+    
+    Dict() = default;
+    explicit Dict(std::pmr::memory_resource* resource);
+    
+    bool empty() const;
+    size_t size() const;
+    
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    
+    iterator find(std::string_view key);
+    const_iterator find(std::string_view key) const;
+    size_t count(std::string_view key) const;
+    Node& at(std::string_view key);
+    const Node& at(std::string_view key) const;
+    Node& operator[](std::string_view key);
+    std::pair<iterator, bool> try_emplace(std::string_view key);
+    
+    // Для разбора: пары добавляются в конец как есть, затем SortKeys упорядочивает их
+    // разом и возвращает первую пару с повторяющимся ключом или end()
+    void Reserve(size_t size);
+    void AppendUnsorted(value_type&& item);
+    iterator SortKeys();
+    
+private:
+    std::pmr::vector<value_type> items_;
+    
+    iterator LowerBound(std::string_view key);
+    const_iterator LowerBound(std::string_view key) const;
+};
+
 class Node  final
-    : private std::variant<nullptr_t, Array, Dict, bool, int, double, std::string>
+    : private std::variant<nullptr_t, Array, Dict, bool, int, double, String>
     {
 public:
     using variant::variant;
     using Value = variant;
     
     Node(Value value);
+    Node(std::string_view value);
+    Node(const std::string& value);
+    Node(const char* value);
     
     bool IsInt() const;
     bool IsPureDouble() const;
@@ -38,7 +87,7 @@ public:
     int AsInt() const;
     bool AsBool() const;
     double AsDouble() const;
-    const std::string& AsString() const;
+    std::string_view AsString() const;
     const Array& AsArray() const;
     Array& AsArray();
     const Dict& AsDict() const;
@@ -57,15 +106,27 @@ inline bool operator!=(const Node& lhs, const Node& rhs)
 {
     return !(lhs == rhs);
 }
+    
+inline bool operator==(const Dict& lhs, const Dict& rhs)
+{
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+inline bool operator!=(const Dict& lhs, const Dict& rhs)
+{
+    return !(lhs == rhs);
+}
 
 class Document {
 public:
     explicit Document(Node root);
+    // Корень может жить в арене, которой владеет root; тогда узлы не разрушаются по одному
+    explicit Document(std::shared_ptr<const Node> root);
 
     const Node& GetRoot() const;
 
 private:
-    Node root_;
+    std::shared_ptr<const Node> root_;
 };
     
 inline bool operator==(const Document& lhs, const Document& rhs)
@@ -78,7 +139,46 @@ inline bool operator!=(const Document& lhs, const Document& rhs)
     return !(lhs == rhs);
 }
 
+// Обработчик событий потокового разбора. Строки и ключи действительны
+// только до возврата из обработчика; повторяющиеся ключи не проверяются
+class Handler {
+public:
+    virtual void Null() = 0;
+    virtual void Bool(bool value) = 0;
+    virtual void Int(int value) = 0;
+    virtual void Double(double value) = 0;
+    virtual void String(std::string_view value) = 0;
+    virtual void Key(std::string_view key) = 0;
+    virtual void StartDict() = 0;
+    virtual void EndDict() = 0;
+    virtual void StartArray() = 0;
+    virtual void EndArray() = 0;
+    
+protected:
+    ~Handler() = default;
+};
+
+// Поток читается по частям, по мере разбора
 Document Load(std::istream& input);
+Document Load(std::string_view text);
+
+// Разбирает JSON, не строя документ, и сообщает о значениях обработчику
+void Parse(std::istream& input, Handler& handler);
+void Parse(std::string_view text, Handler& handler);
+// То же для одного значения, занимающего весь text; false, если после него осталось
+// что-то кроме пробельных символов
+bool ParseWhole(std::string_view text, Handler& handler);
+
+// Массив под ключом key корневого словаря и его элементы как участки text
+struct RootArray {
+    std::string_view array;
+    std::vector<std::string_view> items;
+};
+
+// Находит элементы массива, проходя только по структуре: учитываются строки и вложенность,
+// а синтаксис самих элементов проверяет их разбор. Как и при обычном разборе, запятые между
+// элементами необязательны. Пусто, если массива нет, ключ повторяется или структура нарушена
+std::optional<RootArray> FindRootArray(std::string_view text, std::string_view key);
 
 void Print(const Document& doc, std::ostream& output);
 
@@ -30,9 +30,9 @@ KeyItemContext Builder::Key(string key) {
     return *this;
 }
     
-BaseContext Builder::Value(Node::Value value) {
+BaseContext Builder::Value(Node value) {
     if (root_ == nullptr) {
-        root_.GetValue() = move(value);
+        root_ = move(value);
         return *this;
     }
     
@@ -149,7 +149,7 @@ Node Builder::Build() {
 KeyItemContext BaseContext::Key(std::string key) {
     return builder_.Key(move(key));
 }
-BaseContext BaseContext::Value(Node::Value value) {
+BaseContext BaseContext::Value(Node value) {
     return builder_.Value(move(value));
 }  
 DictValueItemContext BaseContext::StartDict() {
@@ -168,7 +168,7 @@ Node BaseContext::Build() {
     return builder_.Build();
 }
     
-DictValueItemContext KeyItemContext::Value(Node::Value value) {
+DictValueItemContext KeyItemContext::Value(Node value) {
     return BaseContext::Value(move(value));
 }
 DictValueItemContext KeyItemContext::StartDict() {
@@ -182,7 +182,7 @@ KeyItemContext DictValueItemContext::Key(std::string key) {
     return BaseContext::Key(move(key));
 }
     
-ArrayItemContext ArrayItemContext::Value(Node::Value value) {
+ArrayItemContext ArrayItemContext::Value(Node value) {
     return BaseContext::Value(move(value));
 }
 DictValueItemContext ArrayItemContext::StartDict() {
@@ -17,7 +17,7 @@ class Builder {
 public:
     Builder() = default;
     KeyItemContext Key(std::string key);
-    BaseContext Value(Node::Value value);
+    BaseContext Value(Node value);
     DictValueItemContext StartDict();
     ArrayItemContext StartArray();
     BaseContext EndDict();
@@ -35,7 +35,7 @@ public:
     BaseContext(Builder& builder) : builder_(builder) {}
     
     KeyItemContext Key(std::string key);
-    BaseContext Value(Node::Value value);
+    BaseContext Value(Node value);
     DictValueItemContext StartDict();
     ArrayItemContext StartArray();
     BaseContext EndDict();
@@ -49,7 +49,7 @@ class KeyItemContext : public BaseContext {
 public:
     KeyItemContext(Builder& builder) : BaseContext(builder) {}
     
-    DictValueItemContext Value(Node::Value value);
+    DictValueItemContext Value(Node value);
     DictValueItemContext StartDict();
     ArrayItemContext StartArray();
     
@@ -66,7 +66,7 @@ public:
     
     KeyItemContext Key(std::string key);
     
-    BaseContext Value(Node::Value value) = delete;
+    BaseContext Value(Node value) = delete;
     DictValueItemContext StartDict() = delete;
     ArrayItemContext StartArray() = delete;
     BaseContext EndArray() = delete;
@@ -78,7 +78,7 @@ public:
     ArrayItemContext(Builder& builder) : BaseContext(builder) {}
     ArrayItemContext(BaseContext base) : BaseContext(base) {}
  
-    ArrayItemContext Value(Node::Value value);
+    ArrayItemContext Value(Node value);
     DictValueItemContext StartDict();
     ArrayItemContext StartArray();
     
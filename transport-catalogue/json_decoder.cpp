@@ -0,0 +1,207 @@
+#include "json_decoder.h"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+
+using namespace std;
+
+namespace json {
+
+void ValueDecoder::Set(const Target& target, const Scalar&) const {
+    ThrowTypeError(target);
+}
+
+void ValueDecoder::StartDict(const Target& target) const {
+    ThrowTypeError(target);
+}
+
+void ValueDecoder::StartArray(const Target& target) const {
+    ThrowTypeError(target);
+}
+
+Target ValueDecoder::Key(const Target&, string_view, uint64_t&) const {
+    return {};
+}
+
+Target ValueDecoder::Element(const Target&, uint64_t&) const {
+    return {};
+}
+
+void ValueDecoder::EndElement(const Target&) const {
+}
+
+void ValueDecoder::EndDict(const Target&, uint64_t) const {
+}
+
+void ValueDecoder::EndArray(const Target&, uint64_t) const {
+}
+
+void ValueDecoder::ThrowTypeError(const Target& target) const {
+    string message = target.is_item ? "Items of "s : ""s;
+    message += target.name;
+    message += " must be "sv;
+    message += Expected();
+    throw logic_error(message);
+}
+
+void Decoder<int>::Set(const Target& target, const Scalar& value) const {
+    if (const int* number = get_if<int>(&value)) {
+        Object(target) = *number;
+    } else {
+        ThrowTypeError(target);
+    }
+}
+
+string_view Decoder<int>::Expected() const {
+    return "an integer"sv;
+}
+
+void Decoder<double>::Set(const Target& target, const Scalar& value) const {
+    if (const double* number = get_if<double>(&value)) {
+        Object(target) = *number;
+    } else if (const int* number = get_if<int>(&value)) {
+        Object(target) = *number;
+    } else {
+        ThrowTypeError(target);
+    }
+}
+
+string_view Decoder<double>::Expected() const {
+    return "a number"sv;
+}
+
+void Decoder<bool>::Set(const Target& target, const Scalar& value) const {
+    if (const bool* flag = get_if<bool>(&value)) {
+        Object(target) = *flag;
+    } else {
+        ThrowTypeError(target);
+    }
+}
+
+string_view Decoder<bool>::Expected() const {
+    return "a boolean"sv;
+}
+
+void Decoder<string>::Set(const Target& target, const Scalar& value) const {
+    if (const string_view* text = get_if<string_view>(&value)) {
+        Object(target).assign(*text);
+    } else {
+        ThrowTypeError(target);
+    }
+}
+
+string_view Decoder<string>::Expected() const {
+    return "a string"sv;
+}
+
+DecodingHandler::DecodingHandler(Target root)
+    : next_(root) {
+}
+
+void DecodingHandler::Null() {
+    SetValue(nullptr);
+}
+
+void DecodingHandler::Bool(bool value) {
+    SetValue(value);
+}
+
+void DecodingHandler::Int(int value) {
+    SetValue(value);
+}
+
+void DecodingHandler::Double(double value) {
+    SetValue(value);
+}
+
+void DecodingHandler::String(string_view value) {
+    SetValue(value);
+}
+
+void DecodingHandler::Key(string_view key) {
+    if (skipped_ == 0) {
+        Frame& frame = stack_.back();
+        next_ = frame.target.decoder->Key(frame.target, key, frame.state);
+    }
+}
+
+void DecodingHandler::StartDict() {
+    Start(false);
+}
+
+void DecodingHandler::EndDict() {
+    End();
+}
+
+void DecodingHandler::StartArray() {
+    Start(true);
+}
+
+void DecodingHandler::EndArray() {
+    End();
+}
+
+Target DecodingHandler::NextTarget() {
+    if (!stack_.empty() && stack_.back().is_array) {
+        Frame& frame = stack_.back();
+        return frame.target.decoder->Element(frame.target, frame.state);
+    }
+    return next_;
+}
+
+void DecodingHandler::SetValue(const Scalar& value) {
+    if (skipped_ > 0) {
+        return;
+    }
+    const Target target = NextTarget();
+    if (target.decoder != nullptr) {
+        target.decoder->Set(target, value);
+    }
+    EndValue();
+}
+
+void DecodingHandler::Start(bool is_array) {
+    if (skipped_ > 0) {
+        ++skipped_;
+        return;
+    }
+    const Target target = NextTarget();
+    if (target.decoder == nullptr) {
+        skipped_ = 1;
+        return;
+    }
+    if (is_array) {
+        target.decoder->StartArray(target);
+    } else {
+        target.decoder->StartDict(target);
+    }
+    stack_.push_back({target, is_array, 0});
+}
+
+void DecodingHandler::End() {
+    if (skipped_ > 0) {
+        if (--skipped_ == 0) {
+            EndValue();
+        }
+        return;
+    }
+    const Frame& frame = stack_.back();
+    if (frame.is_array) {
+        frame.target.decoder->EndArray(frame.target, frame.state);
+    } else {
+        frame.target.decoder->EndDict(frame.target, frame.state);
+    }
+    stack_.pop_back();
+    EndValue();
+}
+
+void DecodingHandler::EndValue() {
+    if (!stack_.empty() && stack_.back().is_array) {
+        const Frame& frame = stack_.back();
+        frame.target.decoder->EndElement(frame.target);
+    }
+}
+
+}  // namespace json
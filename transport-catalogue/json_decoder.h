@@ -0,0 +1,305 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "json.h"
+
+namespace json {
+
+class ValueDecoder;
+
+// Скалярное значение разбора; строка действительна только до возврата из декодера
+using Scalar = std::variant<std::nullptr_t, bool, int, double, std::string_view>;
+
+// Куда разбирается значение: объект и декодер его типа. Без декодера значение пропускается.
+// name — ключ из схемы для сообщений об ошибках, is_item — значение лежит в массиве name
+struct Target {
+    const ValueDecoder* decoder = nullptr;
+    void* object = nullptr;
+    std::string_view name;
+    bool is_item = false;
+};
+
+// Разбирает значения одного типа C++. Экземпляр один на тип и не хранит состояния: состояние
+// открытого контейнера (отметки прочитанных полей словаря, число элементов массива) хранит
+// разбор и передаёт в state. По умолчанию значение неподходящего вида — ошибка
+class ValueDecoder {
+public:
+    virtual void Set(const Target& target, const Scalar& value) const;
+    virtual void StartDict(const Target& target) const;
+    virtual void StartArray(const Target& target) const;
+    // Куда разбирается значение под ключом key
+    virtual Target Key(const Target& target, std::string_view key, uint64_t& state) const;
+    // Куда разбирается очередной элемент массива
+    virtual Target Element(const Target& target, uint64_t& state) const;
+    // Элемент массива прочитан целиком
+    virtual void EndElement(const Target& target) const;
+    virtual void EndDict(const Target& target, uint64_t state) const;
+    virtual void EndArray(const Target& target, uint64_t state) const;
+
+protected:
+    ~ValueDecoder() = default;
+
+    // Что ожидается на месте значения, для сообщения об ошибке: "an integer", "a dict"
+    virtual std::string_view Expected() const = 0;
+    [[noreturn]] void ThrowTypeError(const Target& target) const;
+};
+
+template <typename T>
+class TypedDecoder : public ValueDecoder {
+protected:
+    ~TypedDecoder() = default;
+
+    static T& Object(const Target& target) {
+        return *static_cast<T*>(target.object);
+    }
+};
+
+// Декодер типа T; для структур его задаёт таблица полей Schema<T>
+template <typename T, typename = void>
+class Decoder;
+
+template <typename T>
+inline const Decoder<T> DECODER{};
+
+template <typename T>
+Target MakeTarget(T& object, std::string_view name, bool is_item = false) {
+    return {&DECODER<T>, &object, name, is_item};
+}
+
+// Необязательное значение создаётся, как только встретился его ключ
+template <typename T>
+Target MakeTarget(std::optional<T>& object, std::string_view name, bool is_item = false) {
+    return MakeTarget(object.emplace(), name, is_item);
+}
+
+// Поле структуры T: ключ в JSON и то, куда разбирается его значение
+template <typename T>
+struct Field {
+    std::string_view key;
+    Target (*target)(T& object, std::string_view key);
+    bool required = false;
+};
+
+inline constexpr bool REQUIRED = true;
+
+namespace detail {
+template <typename Member>
+struct MemberTraits;
+
+template <typename Class, typename Value>
+struct MemberTraits<Value Class::*> {
+    using ClassType = Class;
+};
+} // namespace detail
+
+// Поле key разбирается в object.*member
+template <auto member, typename T = typename detail::MemberTraits<decltype(member)>::ClassType>
+constexpr Field<T> MakeField(std::string_view key, bool required = false) {
+    return {key, [](T& object, std::string_view name) {
+        return MakeTarget(object.*member, name);
+    }, required};
+}
+
+// Специализация задаёт для структуры T таблицу полей:
+//     static constexpr std::array FIELDS{MakeField<&T::name>("name", REQUIRED), ...};
+// Неизвестные ключи пропускаются, повтор известного — ошибка, как и отсутствие обязательного
+template <typename T>
+struct Schema;
+
+template <typename T>
+class Decoder<T, std::void_t<decltype(Schema<T>::FIELDS)>> final : public TypedDecoder<T> {
+public:
+    void StartDict(const Target&) const override {
+    }
+
+    Target Key(const Target& target, std::string_view key, uint64_t& state) const override {
+        // Полей немного, и перебор по таблице обходится дешевле поиска
+        for (size_t i = 0; i < FIELDS.size(); ++i) {
+            if (FIELDS[i].key != key) {
+                continue;
+            }
+            if (state & (uint64_t{1} << i)) {
+                throw ParsingError("Duplicate key '" + std::string(key) + "' have been found");
+            }
+            state |= uint64_t{1} << i;
+            return FIELDS[i].target(this->Object(target), FIELDS[i].key);
+        }
+        return {};
+    }
+
+    void EndDict(const Target& target, uint64_t state) const override {
+        for (size_t i = 0; i < FIELDS.size(); ++i) {
+            if (FIELDS[i].required && !(state & (uint64_t{1} << i))) {
+                throw std::logic_error("Missing " + std::string(FIELDS[i].key) + " in " + std::string(target.name));
+            }
+        }
+    }
+
+private:
+    static constexpr const auto& FIELDS = Schema<T>::FIELDS;
+    static_assert(FIELDS.size() <= 64, "Fields are marked with bits of uint64_t");
+
+    std::string_view Expected() const override {
+        return "a dict";
+    }
+};
+
+template <>
+class Decoder<int> final : public TypedDecoder<int> {
+public:
+    void Set(const Target& target, const Scalar& value) const override;
+private:
+    std::string_view Expected() const override;
+};
+
+template <>
+class Decoder<double> final : public TypedDecoder<double> {
+public:
+    void Set(const Target& target, const Scalar& value) const override;
+private:
+    std::string_view Expected() const override;
+};
+
+template <>
+class Decoder<bool> final : public TypedDecoder<bool> {
+public:
+    void Set(const Target& target, const Scalar& value) const override;
+private:
+    std::string_view Expected() const override;
+};
+
+template <>
+class Decoder<std::string> final : public TypedDecoder<std::string> {
+public:
+    void Set(const Target& target, const Scalar& value) const override;
+private:
+    std::string_view Expected() const override;
+};
+
+template <typename T>
+class Decoder<std::vector<T>> final : public TypedDecoder<std::vector<T>> {
+public:
+    void StartArray(const Target&) const override {
+    }
+
+    Target Element(const Target& target, uint64_t&) const override {
+        return MakeTarget(this->Object(target).emplace_back(), target.name, true);
+    }
+
+private:
+    std::string_view Expected() const override {
+        return "an array";
+    }
+};
+
+// Словарь с произвольными ключами, в порядке документа
+template <typename T>
+class Decoder<std::vector<std::pair<std::string, T>>> final : public TypedDecoder<std::vector<std::pair<std::string, T>>> {
+public:
+    void StartDict(const Target&) const override {
+    }
+
+    Target Key(const Target& target, std::string_view key, uint64_t&) const override {
+        return MakeTarget(this->Object(target).emplace_back(key, T{}).second, target.name, true);
+    }
+
+private:
+    std::string_view Expected() const override {
+        return "a dict";
+    }
+};
+
+// Массив, элементы которого передаются consume по одному, как только прочитаны
+template <typename T>
+struct Each {
+    std::function<void(T& item)> consume;
+    T item;
+};
+
+template <typename T>
+class Decoder<Each<T>> final : public TypedDecoder<Each<T>> {
+public:
+    void StartArray(const Target&) const override {
+    }
+
+    Target Element(const Target& target, uint64_t&) const override {
+        Each<T>& each = this->Object(target);
+        each.item = T{};
+        return MakeTarget(each.item, target.name, true);
+    }
+
+    void EndElement(const Target& target) const override {
+        Each<T>& each = this->Object(target);
+        if (each.consume) {
+            each.consume(each.item);
+        }
+    }
+
+private:
+    std::string_view Expected() const override {
+        return "an array";
+    }
+};
+
+// Ведёт разбор по декодерам, начиная с root, и пропускает значения без декодера
+class DecodingHandler final : public Handler {
+public:
+    explicit DecodingHandler(Target root);
+
+    void Null() override;
+    void Bool(bool value) override;
+    void Int(int value) override;
+    void Double(double value) override;
+    void String(std::string_view value) override;
+    void Key(std::string_view key) override;
+    void StartDict() override;
+    void EndDict() override;
+    void StartArray() override;
+    void EndArray() override;
+
+private:
+    struct Frame {
+        Target target;
+        bool is_array;
+        uint64_t state;
+    };
+
+    std::vector<Frame> stack_;
+    // Значение под последним ключом словаря
+    Target next_;
+    // Глубина внутри пропускаемого значения
+    int skipped_ = 0;
+
+    Target NextTarget();
+    void SetValue(const Scalar& value);
+    void Start(bool is_array);
+    void End();
+    void EndValue();
+};
+
+// Разбирает JSON прямо в object, не строя документ; name называет корень в сообщениях об ошибках
+template <typename T>
+void Decode(std::istream& input, T& object, std::string_view name) {
+    DecodingHandler handler(MakeTarget(object, name));
+    Parse(input, handler);
+}
+
+template <typename T>
+void Decode(std::string_view text, T& object, std::string_view name) {
+    DecodingHandler handler(MakeTarget(object, name));
+    Parse(text, handler);
+}
+
+}  // namespace json
@@ -1,294 +1,960 @@
 #include "json.h"
+#include "json_decoder.h"
 #include "domain.h"
 #include "json_reader.h"
-#include "json_builder.h"
 #include "map_renderer.h"
 #include "transport_catalogue.h"
 #include "transport_router.h"
 #include "serialization.h"
+#include "flat_base.h"
+#include "memory_report.h"
 
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <vector>
 #include <string>
 #include <sstream>
 #include <string_view>
+#include <utility>
 
 using namespace std;
 
 namespace io {
-JsonReader::JsonReader(tcat::TransportCatalogue& catalogue, map_r::MapRenderer& map_renderer) : catalogue_(catalogue), map_renderer_(map_renderer) {}
     
+namespace {
+// Элемент base_requests. Поля остановки и автобуса собраны вместе: type может идти
+// после остальных ключей, и что это за запрос, становится ясно только в конце словаря
+struct BaseRequest {
+    string type;
+    string name;
+    optional<double> latitude;
+    optional<double> longitude;
+    vector<pair<string, int>> road_distances;
+    vector<string> stops;
+    optional<bool> is_roundtrip;
+};
     
-void JsonReader::LoadBaseQueries(istream& input) {
-    doc_ = json::Load(input);
-    const json::Dict& dict = doc_.GetRoot().AsDict();
+// Корневой словарь make_base; элементы base_requests уходят в consume по мере чтения
+struct BaseDocument {
+    json::Each<BaseRequest> base_requests;
+    optional<map_r::RenderSettings> render_settings;
+    optional<router::RouterSettings> routing_settings;
+    optional<serialization::SerializationSettings> serialization_settings;
+};
+    
+// Корневой словарь process_requests
+struct StatDocument {
+    json::Each<StatRequest> stat_requests;
+    // Без stat_requests ответ не выводится вовсе, с пустым массивом выводится []
+    bool has_stat_requests = false;
+    optional<serialization::SerializationSettings> serialization_settings;
+};
+} // namespace
+    
+} // namespace io
+    
+namespace json {
+    
+template <>
+struct Schema<io::BaseRequest> {
+    static constexpr array FIELDS{
+        MakeField<&io::BaseRequest::type>("type"sv),
+        MakeField<&io::BaseRequest::name>("name"sv),
+        MakeField<&io::BaseRequest::latitude>("latitude"sv),
+        MakeField<&io::BaseRequest::longitude>("longitude"sv),
+        MakeField<&io::BaseRequest::road_distances>("road_distances"sv),
+        MakeField<&io::BaseRequest::stops>("stops"sv),
+        MakeField<&io::BaseRequest::is_roundtrip>("is_roundtrip"sv),
+    };
+};
+    
+template <>
+struct Schema<io::StatRequest> {
+    static constexpr array FIELDS{
+        MakeField<&io::StatRequest::id>("id"sv, REQUIRED),
+        MakeField<&io::StatRequest::type>("type"sv, REQUIRED),
+        MakeField<&io::StatRequest::name>("name"sv),
+        MakeField<&io::StatRequest::from>("from"sv),
+        MakeField<&io::StatRequest::to>("to"sv),
+    };
+};
+    
+template <>
+struct Schema<map_r::RenderSettings> {
+    static constexpr array FIELDS{
+        MakeField<&map_r::RenderSettings::width>("width"sv, REQUIRED),
+        MakeField<&map_r::RenderSettings::height>("height"sv, REQUIRED),
+        MakeField<&map_r::RenderSettings::padding>("padding"sv, REQUIRED),
+        MakeField<&map_r::RenderSettings::line_width>("line_width"sv, REQUIRED),
+        MakeField<&map_r::RenderSettings::stop_radius>("stop_radius"sv, REQUIRED),
+        MakeField<&map_r::RenderSettings::bus_label_font_size>("bus_label_font_size"sv, REQUIRED),
+        MakeField<&map_r::RenderSettings::bus_label_offset>("bus_label_offset"sv, REQUIRED),
+        MakeField<&map_r::RenderSettings::stop_label_font_size>("stop_label_font_size"sv, REQUIRED),
+        MakeField<&map_r::RenderSettings::stop_label_offset>("stop_label_offset"sv, REQUIRED),
+        MakeField<&map_r::RenderSettings::underlayer_color>("underlayer_color"sv, REQUIRED),
+        MakeField<&map_r::RenderSettings::underlayer_width>("underlayer_width"sv, REQUIRED),
+        MakeField<&map_r::RenderSettings::color_palette>("color_palette"sv, REQUIRED),
+    };
+};
+    
+template <>
+struct Schema<router::RouterSettings> {
+    static constexpr array FIELDS{
+        MakeField<&router::RouterSettings::bus_wait_time>("bus_wait_time"sv, REQUIRED),
+        MakeField<&router::RouterSettings::bus_velocity>("bus_velocity"sv, REQUIRED),
+    };
+};
+    
+template <>
+struct Schema<serialization::SerializationSettings> {
+    static constexpr array FIELDS{
+        MakeField<&serialization::SerializationSettings::file>("file"sv, REQUIRED),
+        MakeField<&serialization::SerializationSettings::format>("format"sv),
+        MakeField<&serialization::SerializationSettings::compression>("compression"sv),
+        MakeField<&serialization::SerializationSettings::parent>("parent"sv),
+        MakeField<&serialization::SerializationSettings::deltas>("deltas"sv),
+        MakeField<&serialization::SerializationSettings::prerender_map>("prerender_map"sv),
+    };
+};
+    
+template <>
+struct Schema<io::BaseDocument> {
+    static constexpr array FIELDS{
+        MakeField<&io::BaseDocument::base_requests>("base_requests"sv),
+        MakeField<&io::BaseDocument::render_settings>("render_settings"sv),
+        MakeField<&io::BaseDocument::routing_settings>("routing_settings"sv),
+        MakeField<&io::BaseDocument::serialization_settings>("serialization_settings"sv),
+    };
+};
+    
+template <>
+struct Schema<io::StatDocument> {
+    static constexpr array FIELDS{
+        Field<io::StatDocument>{"stat_requests"sv, [](io::StatDocument& document, string_view name) {
+            document.has_stat_requests = true;
+            return MakeTarget(document.stat_requests, name);
+        }},
+        MakeField<&io::StatDocument::serialization_settings>("serialization_settings"sv),
+    };
+};
+    
+// Смещение подписи: массив из двух чисел, остальные элементы не читаются
+template <>
+class Decoder<svg::Point> final : public TypedDecoder<svg::Point> {
+public:
+    void StartArray(const Target&) const override {
+    }
+    
+    Target Element(const Target& target, uint64_t& count) const override {
+        svg::Point& point = Object(target);
+        switch (count++) {
+            case 0:
+                return MakeTarget(point.x, target.name, true);
+            case 1:
+                return MakeTarget(point.y, target.name, true);
+            default:
+                return {};
+        }
+    }
+    
+    void EndArray(const Target& target, uint64_t count) const override {
+        if (count < 2) {
+            ThrowTypeError(target);
+        }
+    }
+    
+private:
+    string_view Expected() const override {
+        return "an array of two numbers"sv;
+    }
+};
     
-    const auto base_reqs = dict.find("base_requests"s);
-    if (base_reqs != dict.end()) {
-        ParseBaseRequests(base_reqs->second.AsArray());
+// Составляющая цвета: целое число, которое приводится к байту
+template <>
+class Decoder<uint8_t> final : public TypedDecoder<uint8_t> {
+public:
+    void Set(const Target& target, const Scalar& value) const override {
+        if (const int* number = get_if<int>(&value)) {
+            Object(target) = static_cast<uint8_t>(*number);
+        } else {
+            ThrowTypeError(target);
+        }
+    }
+    
+private:
+    string_view Expected() const override {
+        return "an integer"sv;
+    }
+};
+    
+// Цвет задаётся строкой или массивом [r, g, b] либо [r, g, b, opacity]. Массив читается
+// в Rgba и становится Rgb, если в нём три элемента; при другой длине, как и вместо
+// строки или массива, цвет не задан
+template <>
+class Decoder<svg::Color> final : public TypedDecoder<svg::Color> {
+public:
+    void Set(const Target& target, const Scalar& value) const override {
+        if (const string_view* name = get_if<string_view>(&value)) {
+            Object(target) = string(*name);
+        } else {
+            Object(target) = svg::Color();
+        }
     }
     
+    void StartArray(const Target& target) const override {
+        Object(target) = svg::Rgba();
+    }
+    
+    Target Element(const Target& target, uint64_t& count) const override {
+        svg::Rgba& rgba = get<svg::Rgba>(Object(target));
+        switch (count++) {
+            case 0:
+                return MakeTarget(rgba.red, target.name, true);
+            case 1:
+                return MakeTarget(rgba.green, target.name, true);
+            case 2:
+                return MakeTarget(rgba.blue, target.name, true);
+            case 3:
+                return MakeTarget(rgba.opacity, target.name, true);
+            default:
+                return {};
+        }
+    }
+    
+    void EndArray(const Target& target, uint64_t count) const override {
+        svg::Color& color = Object(target);
+        if (count == 3) {
+            const svg::Rgba rgba = get<svg::Rgba>(color);
+            color = svg::Rgb(rgba.red, rgba.green, rgba.blue);
+        } else if (count != 4) {
+            color = svg::Color();
+        }
+    }
+    
+private:
+    string_view Expected() const override {
+        return "a color"sv;
+    }
+};
+    
+template <>
+class Decoder<serialization::BaseFormat> final : public TypedDecoder<serialization::BaseFormat> {
+public:
+    void Set(const Target& target, const Scalar& value) const override {
+        const string_view* format = get_if<string_view>(&value);
+        if (format == nullptr) {
+            ThrowTypeError(target);
+        }
+        if (*format == "flat"sv) {
+            Object(target) = serialization::BaseFormat::FLAT;
+        } else if (*format == "protobuf"sv) {
+            Object(target) = serialization::BaseFormat::PROTOBUF;
+        } else {
+            throw invalid_argument("Unknown base format "s + string(*format));
+        }
+    }
+    
+private:
+    string_view Expected() const override {
+        return "a string"sv;
+    }
+};
+    
+template <>
+class Decoder<serialization::Compression> final : public TypedDecoder<serialization::Compression> {
+public:
+    void Set(const Target& target, const Scalar& value) const override {
+        const string_view* compression = get_if<string_view>(&value);
+        if (compression == nullptr) {
+            ThrowTypeError(target);
+        }
+        if (*compression == "gzip"sv) {
+            Object(target) = serialization::Compression::GZIP;
+        } else if (*compression == "none"sv) {
+            Object(target) = serialization::Compression::NONE;
+        } else {
+            throw invalid_argument("Unknown base compression "s + string(*compression));
+        }
+    }
+    
+private:
+    string_view Expected() const override {
+        return "a string"sv;
+    }
+};
+    
+} // namespace json
+    
+namespace io {
+    
+namespace {
+struct PendingDistance {
+    // Номер остановки в BaseRequests::stops
+    size_t from_id;
+    string to;
+    int distance;
+};
+    
+// Часть base_requests в порядке документа
+struct BaseRequests {
+    vector<tcat::Stop> stops;
+    vector<PendingDistance> distances;
+    vector<tcat::PreBus> buses;
+};
+    
+// Запросы других типов пропускаются
+void AddBaseRequest(BaseRequests& requests, BaseRequest& request) {
+    if (request.type == "Stop"sv) {
+        if (!request.latitude || !request.longitude) {
+            throw logic_error("Stop "s + request.name + " has no coordinates"s);
+        }
+        tcat::Stop stop;
+        stop.name = move(request.name);
+        stop.coordinates = geo::ToStored(geo::Coordinates{*request.latitude, *request.longitude});
+        const size_t id = requests.stops.size();
+        requests.stops.push_back(move(stop));
+        for (auto& [to, distance] : request.road_distances) {
+            requests.distances.push_back({id, move(to), distance});
+        }
+    } else if (request.type == "Bus"sv) {
+        if (!request.is_roundtrip) {
+            throw logic_error("Bus "s + request.name + " has no is_roundtrip"s);
+        }
+        requests.buses.push_back({move(request.name), move(request.stops), *request.is_roundtrip});
+    }
+}
+    
+// Добавляет части base_requests в справочник по порядку: сначала все остановки, затем
+// расстояния и автобусы, которые ссылаются на остановки по именам
+void AddBaseRequests(tcat::TransportCatalogue& catalogue, vector<BaseRequests>& parts) {
+    vector<size_t> first_stop_ids;
+    first_stop_ids.reserve(parts.size());
+    for (BaseRequests& part : parts) {
+        first_stop_ids.push_back(catalogue.GetAllStopsCount());
+        for (const tcat::Stop& stop : part.stops) {
+            catalogue.AddStop(stop);
+        }
+        part.stops = {};
+    }
+    for (size_t i = 0; i < parts.size(); ++i) {
+        for (const auto& [from_id, to, distance] : parts[i].distances) {
+            catalogue.AddDistance(catalogue.GetStop(first_stop_ids[i] + from_id), catalogue.FindStop(to), distance);
+        }
+        parts[i].distances = {};
+    }
+    for (BaseRequests& part : parts) {
+        for (const auto& pre_bus : part.buses) {
+            catalogue.AddBus(pre_bus);
+        }
+        part.buses = {};
+    }
+    catalogue.BuildNameIndex();
+}
+    
+// Сочетания, которые разбор по полям пропустить не может: они зависят от нескольких ключей
+void CheckSerializationSettings(const serialization::SerializationSettings& settings) {
+    if (settings.format != serialization::BaseFormat::FLAT) {
+        return;
+    }
+    if (settings.compression != serialization::Compression::NONE) {
+        throw invalid_argument("Flat base is mapped in place and cannot be compressed"s);
+    }
+    if (!settings.parent.empty() || !settings.deltas.empty()) {
+        throw invalid_argument("Deltas are only supported for protobuf bases"s);
+    }
+}
+    
+// Ответы копятся в буфере и уходят в поток крупными порциями
+constexpr size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+// При параллельных ответах поток берёт запросы порциями; готовых, но ещё не выведенных
+// порций не больше RESPONSE_WINDOW_PER_THREAD на поток
+constexpr size_t RESPONSE_CHUNK_SIZE = 64;
+constexpr size_t RESPONSE_WINDOW_PER_THREAD = 8;
+    
+void Flush(string& buffer, ostream& output) {
+    output.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    buffer.clear();
+}
+    
+template <typename Input>
+vector<BaseRequests> ParseBaseQueries(Input& input, BaseDocument& document) {
+    vector<BaseRequests> parts(1);
+    document.base_requests.consume = [&part = parts.front()](BaseRequest& request) {
+        AddBaseRequest(part, request);
+    };
+    json::Decode(input, document, "Requests"sv);
+    return parts;
+}
+    
+// SVG карты, закодированный строкой JSON, как он стоит в ответе на Map
+string EncodeMap(const map_r::MapRenderer& map_renderer, const tcat::TransportCatalogue& catalogue) {
+    ostringstream svg;
+    map_renderer.RenderMap(catalogue).Render(svg);
+    string map_json;
+    json::Writer(map_json).Value(svg.str());
+    return map_json;
+}
+    
+// Какие поля нужны, зависит от type, поэтому схема их обязательными не помечает
+void CheckStatRequest(const StatRequest& request) {
+    const auto require = [](const optional<string>& field, string_view key) {
+        if (!field) {
+            throw logic_error("Missing "s + string(key) + " in stat_requests"s);
+        }
+    };
+    if (request.type == "Stop"sv || request.type == "Bus"sv) {
+        require(request.name, "name"sv);
+    } else if (request.type == "Route"sv) {
+        require(request.from, "from"sv);
+        require(request.to, "to"sv);
+    }
+}
+    
+template <typename Input>
+vector<StatRequest> ParseStatQueries(Input& input, StatDocument& document) {
+    vector<StatRequest> requests;
+    document.stat_requests.consume = [&requests](StatRequest& request) {
+        CheckStatRequest(request);
+        requests.push_back(move(request));
+    };
+    json::Decode(input, document, "Requests"sv);
+    return requests;
+}
+    
+string ReadAll(istream& input) {
+    constexpr size_t CHUNK_SIZE = 1 << 20;
+    string text;
+    while (true) {
+        const size_t size = text.size();
+        text.resize(size + CHUNK_SIZE);
+        const streamsize read = input.rdbuf()->sgetn(text.data() + size, CHUNK_SIZE);
+        text.resize(size + static_cast<size_t>(read));
+        if (read == 0) {
+            return text;
+        }
+    }
+}
+    
+// Читает вход целиком, находит границы элементов base_requests и разбирает их группами
+// на threads потоках. Остальной документ разбирается отдельно, с пустым base_requests
+vector<BaseRequests> ParseBaseQueriesInParallel(istream& input, BaseDocument& document, size_t threads) {
+    const string text = ReadAll(input);
+    const string_view whole(text);
+    const auto section = json::FindRootArray(text, "base_requests"sv);
+    if (!section || section->items.empty()) {
+        // Нарушенную структуру найдёт и опишет обычный разбор
+        return ParseBaseQueries(whole, document);
+    }
+    const size_t array_offset = static_cast<size_t>(section->array.data() - text.data());
+    string rest = text.substr(0, array_offset);
+    rest += "[]"sv;
+    rest.append(text, array_offset + section->array.size());
+    const string_view rest_text(rest);
+    ParseBaseQueries(rest_text, document);
+    
+    const vector<string_view>& items = section->items;
+    const size_t groups = min(threads, items.size());
+    // nullopt — в элементе после значения осталось ещё что-то (например, пропущена запятая
+    // перед скаляром), и границы элементов надо искать обычным разбором
+    vector<future<optional<BaseRequests>>> parts;
+    parts.reserve(groups);
+    for (size_t i = 0; i < groups; ++i) {
+        parts.push_back(async(launch::async, [&items, first = items.size() * i / groups, last = items.size() * (i + 1) / groups] {
+            BaseRequests part;
+            BaseRequest request;
+            for (size_t j = first; j < last; ++j) {
+                request = BaseRequest{};
+                json::DecodingHandler handler(json::MakeTarget(request, "base_requests"sv, true));
+                if (!json::ParseWhole(items[j], handler)) {
+                    return optional<BaseRequests>();
+                }
+                AddBaseRequest(part, request);
+            }
+            return optional<BaseRequests>(move(part));
+        }));
+    }
+    // Группы забираются по порядку, так что первой всплывает та же ошибка, что и при
+    // разборе подряд
+    vector<BaseRequests> result;
+    result.reserve(groups);
+    for (auto& part : parts) {
+        optional<BaseRequests> requests = part.get();
+        if (!requests) {
+            document = BaseDocument();
+            return ParseBaseQueries(whole, document);
+        }
+        result.push_back(move(*requests));
+    }
+    return result;
+}
+    
+} // namespace
+    
+JsonReader::JsonReader(tcat::TransportCatalogue& catalogue, map_r::MapRenderer& map_renderer) : catalogue_(catalogue), map_renderer_(map_renderer) {}
+    
+    
+void JsonReader::EnableMemoryReport(ostream& report_output) {
+    phases_ = mem::PhaseTracker(report_output);
+}
+    
+void JsonReader::EnableStreaming() {
+    streaming_ = true;
+}
+    
+void JsonReader::EnableCompactOutput() {
+    output_style_ = json::Writer::Style::COMPACT;
+}
+    
+void JsonReader::SetThreadCount(size_t threads) {
+    threads_ = max<size_t>(threads, 1);
+}
+    
+void JsonReader::LoadBaseQueries(istream& input) {
+    BaseDocument document;
+    vector<BaseRequests> parts = threads_ > 1
+        ? ParseBaseQueriesInParallel(input, document, threads_)
+        : ParseBaseQueries(input, document);
+    phases_.Mark("parse json"sv);
+    AddBaseRequests(catalogue_, parts);
+    phases_.Mark("build catalogue"sv);
+    
     tr_ = make_shared<router::TransportRouter>(catalogue_);
     
-    const auto render_reqs = dict.find("render_settings"s);
-    if (render_reqs != dict.end()) {
-        ParseRenderRequests(render_reqs->second.AsDict());
+    if (document.render_settings) {
+        map_renderer_.LoadSettings(move(*document.render_settings));
     }
     
-    const auto routing_reqs = dict.find("routing_settings"s);
-    if (routing_reqs != dict.end()) {
-        ParseRoutingRequests(routing_reqs->second.AsDict());
+    if (document.routing_settings) {
+        tr_->LoadSettings(*document.routing_settings);
     }
+    phases_.Mark("load settings"sv);
     
-    const auto serialization_reqs = dict.find("serialization_settings"s);
-    if (serialization_reqs != dict.end()) {
-        const string serialization_filename = ParseSerializationRequests(serialization_reqs->second.AsDict());
-        serialization::Serializer serializer(catalogue_, tr_, map_renderer_);
-        serializer.SerializeToFile(serialization_filename);
+    if (document.serialization_settings) {
+        const auto& serialization_settings = *document.serialization_settings;
+        CheckSerializationSettings(serialization_settings);
+        if (!serialization_settings.parent.empty()) {
+            serialization::Serializer serializer(catalogue_, tr_, map_renderer_);
+            serializer.SerializeDeltaToFile(serialization_settings.file, serialization_settings.parent, serialization_settings.deltas);
+        } else {
+            SaveBase(serialization_settings, serialization_settings.prerender_map && document.render_settings);
+        }
+        phases_.Mark("serialize"sv);
     }
+    PrintMemoryReport();
 }
     
 void JsonReader::LoadStatQueries(istream& input, ostream& output) {
-    doc_ = json::Load(input);
-    const json::Dict& dict = doc_.GetRoot().AsDict();
-    
-    const auto serialization_reqs = dict.find("serialization_settings"s);
-    if (serialization_reqs != dict.end()) {
-        const string serialization_filename = ParseSerializationRequests(serialization_reqs->second.AsDict());
-	serialization::Serializer serializer(catalogue_, nullptr, map_renderer_);
-        tr_ = serializer.DeserializeFromFile(serialization_filename);
-
-	//tr_ = make_shared<router::TransportRouter>(catalogue_);
+    if (streaming_) {
+        StreamStatQueries(input, output);
+        PrintMemoryReport();
+        return;
+    }
+    StatDocument document;
+    const vector<StatRequest> requests = ParseStatQueries(input, document);
+    phases_.Mark("parse json"sv);
+    
+    if (document.serialization_settings) {
+        const serialization::BaseParts parts = document.has_stat_requests
+            ? GetRequiredBaseParts(requests)
+            : serialization::BaseParts{false, false};
+        LoadBase(*document.serialization_settings, parts);
+        if (parts.router) {
+            tr_->BuildRouter();
+        }
+        if (parts.render_settings) {
+            PrepareMap();
+        }
         
-        const auto stat_reqs = dict.find("stat_requests"s);
-        if (stat_reqs != dict.end()) {
-            ParseStatRequests(stat_reqs->second.AsArray(), output);
+        if (document.has_stat_requests) {
+            OutputResponses(requests, output);
+            phases_.Mark("answer requests"sv);
         }
         
     }
+    PrintMemoryReport();
 }
     
-void JsonReader::ParseBaseRequests(const json::Array& base_requests) const {
-    vector<tcat::Stop> stops;
-    vector<tcat::PreBus> buses;
-    vector<tcat::StopDistances> stop_distances;
-    for (const auto& request : base_requests) {
-        json::Dict req_root = request.AsDict();
-        if (req_root.at("type"s).AsString() == "Stop"s) {
-            stops.push_back(ParseStop(req_root));
-            stop_distances.push_back(ParseStopDistances(req_root));
-        } else if (req_root.at("type"s).AsString() == "Bus"s) {
-            buses.push_back(ParsePreBus(req_root));
+void JsonReader::SaveBase(const serialization::SerializationSettings& serialization_settings, bool prerender_map) {
+    // При одном потоке стадии выполняются по очереди в get()
+    const launch policy = threads_ > 1 ? launch::async : launch::deferred;
+    const auto render_map = [this, prerender_map] {
+        if (prerender_map) {
+            map_renderer_.SetRenderedMap(EncodeMap(map_renderer_, catalogue_));
         }
+    };
+    
+    if (serialization_settings.format == serialization::BaseFormat::FLAT) {
+        serialization::FlatSerializer serializer(catalogue_, tr_, map_renderer_);
+        auto router = async(policy, [this] { tr_->BuildRouter(); });
+        auto map = async(policy, [&serializer, &render_map] {
+            render_map();
+            serializer.EncodeRenderedMapSection();
+        });
+        serializer.EncodeCatalogueSections();
+        router.get();
+        // Рёбра ссылаются на имена из секции справочника
+        serializer.EncodeRouterSections();
+        map.get();
+        serializer.WriteEncodedSections(serialization_settings.file);
+        return;
     }
-    for (const auto& stop : stops) {
-        catalogue_.AddStop(stop);
+    
+    const serialization::Compression compression = serialization_settings.compression;
+    serialization::Serializer serializer(catalogue_, tr_, map_renderer_);
+    auto graph = async(policy, [&serializer, compression] { serializer.EncodeGraphSection(compression); });
+    auto map = async(policy, [&serializer, &render_map, compression] {
+        render_map();
+        serializer.EncodeRenderedMapSection(compression);
+    });
+    serializer.EncodeCatalogueSections(compression);
+    graph.get();
+    map.get();
+    serializer.WriteEncodedSections(serialization_settings.file, compression);
+}
+    
+void JsonReader::AnswerBatch(string_view input, ostream& output) {
+    StatDocument document;
+    vector<StatRequest> requests;
+    try {
+        requests = ParseStatQueries(input, document);
+    } catch (const exception& e) {
+        throw BatchError(e.what());
     }
     
-    for (const auto& stop_to_distances : stop_distances) {
-        catalogue_.AddDistanceBetweenStops(stop_to_distances);
+    if (document.serialization_settings) {
+        const auto& settings = *document.serialization_settings;
+        if (!served_settings_) {
+            try {
+                LoadBase(settings, serialization::BaseParts{});
+                tr_->BuildRouter();
+            } catch (const exception& e) {
+                // Следующий пакет загружает базу заново, с чистого справочника
+                catalogue_ = tcat::TransportCatalogue();
+                map_renderer_.LoadSettings(map_r::RenderSettings{});
+                tr_ = nullptr;
+                throw BatchError(e.what());
+            }
+            served_settings_ = settings;
+            PrintMemoryReport();
+        } else if (settings.file != served_settings_->file || settings.deltas != served_settings_->deltas) {
+            throw BatchError("Another base is already loaded from "s + served_settings_->file);
+        }
+    } else if (!served_settings_) {
+        // Как и process_requests, без базы ничего не выводится
+        return;
     }
-    for (const auto& pre_bus : buses) {
-        catalogue_.AddBus(pre_bus);
+    
+    if (document.has_stat_requests) {
+        try {
+            if (GetRequiredBaseParts(requests).render_settings) {
+                PrepareMap();
+            }
+            OutputResponses(requests, output);
+        } catch (const exception& e) {
+            throw BatchError(e.what());
+        }
     }
 }
     
-tcat::Stop JsonReader::ParseStop(const json::Dict& dict) const {
-    tcat::Stop complete_stop;
-    complete_stop.name = dict.at("name"s).AsString();
-    complete_stop.coordinates = {dict.at("latitude"s).AsDouble(), dict.at("longitude"s).AsDouble()};
-    return complete_stop;
-}
+void JsonReader::StreamStatQueries(istream& input, ostream& output) {
+    // Начало массива уходит в поток вместе с первым ответом, а без stat_requests не выводится
+    string buffer;
+    json::Writer responses(buffer, output_style_);
+    responses.StartArray();
+    bool base_loaded = false;
+    // Запросы, пришедшие раньше serialization_settings
+    vector<StatRequest> pending;
+    StatDocument document;
+    
+    document.stat_requests.consume = [&](StatRequest& request) {
+        CheckStatRequest(request);
+        if (!base_loaded) {
+            if (!document.serialization_settings) {
+                pending.push_back(move(request));
+                return;
+            }
+            // Какие запросы придут дальше, неизвестно: загружается всё, кроме графа,
+            // который маршрутизатор построит сам, если понадобится
+            LoadBase(*document.serialization_settings, serialization::BaseParts{true, true, false});
+            base_loaded = true;
+        }
+        if (request.type == "Route"sv) {
+            tr_->BuildRouter();
+        } else if (request.type == "Map"sv) {
+            PrepareMap();
+        }
+        OutputResponse(responses, request);
+        Flush(buffer, output);
+    };
+    json::Decode(input, document, "Requests"sv);
     
-tcat::PreBus JsonReader::ParsePreBus(const json::Dict& dict) const {
-    tcat::PreBus pre_bus;
-    vector<string> pre_stops;
-    pre_bus.name = dict.at("name"s).AsString();
-    pre_bus.is_circular = dict.at("is_roundtrip"s).AsBool();
-    for (const auto& stop : dict.at("stops"s).AsArray()) {
-        pre_stops.push_back(stop.AsString());
+    if (!document.serialization_settings) {
+        return;
+    }
+    if (!base_loaded) {
+        const serialization::BaseParts parts = document.has_stat_requests
+            ? GetRequiredBaseParts(pending)
+            : serialization::BaseParts{false, false};
+        LoadBase(*document.serialization_settings, parts);
+        if (parts.router) {
+            tr_->BuildRouter();
+        }
+        if (parts.render_settings) {
+            PrepareMap();
+        }
+        for (const auto& request : pending) {
+            OutputResponse(responses, request);
+            Flush(buffer, output);
+        }
+    }
+    if (document.has_stat_requests) {
+        responses.EndArray();
+        Flush(buffer, output);
+        phases_.Mark("answer requests"sv);
     }
-    pre_bus.stops = move(pre_stops);
-    return pre_bus;
 }
     
-tcat::StopDistances JsonReader::ParseStopDistances(const json::Dict& dict) const {
-    tcat::StopDistances stop_with_dists;
-    stop_with_dists.name = dict.at("name"s).AsString();
-    for (const auto& [name, distance] : dict.at("road_distances"s).AsDict()) {
-        stop_with_dists.stop_to_distance.emplace(name, distance.AsInt());
+void JsonReader::OutputResponses(const vector<StatRequest>& requests, ostream& output) const {
+    if (threads_ > 1 && requests.size() > RESPONSE_CHUNK_SIZE) {
+        OutputResponsesInParallel(requests, output);
+        return;
+    }
+    string buffer;
+    json::Writer responses(buffer, output_style_);
+    responses.StartArray();
+    for (const auto& request : requests) {
+        OutputResponse(responses, request);
+        if (buffer.size() >= OUTPUT_BUFFER_SIZE) {
+            Flush(buffer, output);
+        }
     }
-    return stop_with_dists;
+    responses.EndArray();
+    Flush(buffer, output);
 }
     
-void JsonReader::ParseRenderRequests(const json::Dict& render_requests) const {
-    vector<svg::Color> complete_color_palette;
-    for (const json::Node& color : render_requests.at("color_palette"s).AsArray()) {
-        complete_color_palette.push_back(ParseColorData(color));
-    }
-    
-    map_r::RenderSettings render_data {
-        render_requests.at("width"s).AsDouble(),
-        render_requests.at("height"s).AsDouble(),
-        render_requests.at("padding"s).AsDouble(),
-        render_requests.at("line_width"s).AsDouble(),
-        render_requests.at("stop_radius"s).AsDouble(),
-        render_requests.at("bus_label_font_size"s).AsInt(),
-        {render_requests.at("bus_label_offset"s).AsArray().at(0).AsDouble(), render_requests.at("bus_label_offset"s).AsArray().at(1).AsDouble()},
-        render_requests.at("stop_label_font_size"s).AsInt(),
-        {render_requests.at("stop_label_offset"s).AsArray().at(0).AsDouble(), render_requests.at("stop_label_offset"s).AsArray().at(1).AsDouble()},
-        ParseColorData(render_requests.at("underlayer_color"s)),
-        render_requests.at("underlayer_width"s).AsDouble(),
-        move(complete_color_palette)
+void JsonReader::OutputResponsesInParallel(const vector<StatRequest>& requests, ostream& output) const {
+    const size_t chunks = (requests.size() + RESPONSE_CHUNK_SIZE - 1) / RESPONSE_CHUNK_SIZE;
+    const size_t workers = min(threads_, chunks);
+    // Порция c пишется в ячейку c % window; брать её можно, только когда прежняя порция
+    // из этой ячейки уже выведена, так что вперёд готовится не больше window порций
+    const size_t window = min(chunks, workers * RESPONSE_WINDOW_PER_THREAD);
+    vector<string> slots(window);
+    vector<char> ready(window, false);
+    mutex m;
+    condition_variable cv;
+    size_t next_chunk = 0;
+    size_t written = 0;
+    exception_ptr error;
+    
+    const auto work = [&] {
+        unique_lock lock(m);
+        while (true) {
+            cv.wait(lock, [&] {
+                return next_chunk == chunks || next_chunk < written + window;
+            });
+            if (next_chunk == chunks) {
+                return;
+            }
+            const size_t chunk = next_chunk++;
+            lock.unlock();
+            string& slot = slots[chunk % window];
+            slot.clear();
+            try {
+                json::Writer items = json::Writer::ArrayItems(slot, output_style_, chunk > 0);
+                const size_t last = min(requests.size(), (chunk + 1) * RESPONSE_CHUNK_SIZE);
+                for (size_t i = chunk * RESPONSE_CHUNK_SIZE; i < last; ++i) {
+                    OutputResponse(items, requests[i]);
+                }
+            } catch (...) {
+                lock.lock();
+                if (!error) {
+                    error = current_exception();
+                }
+                next_chunk = chunks;
+                cv.notify_all();
+                return;
+            }
+            lock.lock();
+            ready[chunk % window] = true;
+            cv.notify_all();
+        }
     };
-    map_renderer_.LoadSettings(render_data);
+    vector<future<void>> tasks;
+    tasks.reserve(workers);
+    for (size_t i = 0; i < workers; ++i) {
+        tasks.push_back(async(launch::async, work));
+    }
+    
+    string buffer;
+    json::Writer responses(buffer, output_style_);
+    responses.StartArray();
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        unique_lock lock(m);
+        cv.wait(lock, [&] {
+            return ready[chunk % window] || error;
+        });
+        if (error) {
+            break;
+        }
+        ready[chunk % window] = false;
+        lock.unlock();
+        buffer += slots[chunk % window];
+        if (buffer.size() >= OUTPUT_BUFFER_SIZE) {
+            Flush(buffer, output);
+        }
+        lock.lock();
+        ++written;
+        cv.notify_all();
+    }
+    for (auto& task : tasks) {
+        task.get();
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+    responses.EndArray();
+    Flush(buffer, output);
 }
-   
-svg::Color JsonReader::ParseColorData(const json::Node& color) const {
-    if (color.IsString()) {
-        return color.AsString();
-    }
-    else if (color.IsArray()) {
-        if (color.AsArray().size() == 3) {
-            return svg::Rgb {
-                static_cast<uint8_t>(color.AsArray().at(0).AsInt()),
-                static_cast<uint8_t>(color.AsArray().at(1).AsInt()),
-                static_cast<uint8_t>(color.AsArray().at(2).AsInt())
-            };
-        } else if (color.AsArray().size() == 4) {
-            return svg::Rgba {
-                static_cast<uint8_t>(color.AsArray().at(0).AsInt()),
-                static_cast<uint8_t>(color.AsArray().at(1).AsInt()),
-                static_cast<uint8_t>(color.AsArray().at(2).AsInt()),
-                color.AsArray().at(3).AsDouble()
-            };
-        }
-    }
-    return svg::Color();
+    
+void JsonReader::LoadBase(const serialization::SerializationSettings& serialization_settings, serialization::BaseParts parts) {
+    CheckSerializationSettings(serialization_settings);
+    if (serialization::IsFlatBase(serialization_settings.file)) {
+        if (!serialization_settings.deltas.empty()) {
+            throw invalid_argument("Deltas are only supported for protobuf bases"s);
+        }
+        serialization::FlatSerializer serializer(catalogue_, nullptr, map_renderer_);
+        tr_ = serializer.DeserializeFromFile(serialization_settings.file, parts);
+    } else {
+        serialization::Serializer serializer(catalogue_, nullptr, map_renderer_);
+        tr_ = serializer.DeserializeFromFile(serialization_settings.file, parts, serialization_settings.deltas);
+    }
+    phases_.Mark("load base"sv);
 }
     
-void JsonReader::ParseRoutingRequests(const json::Dict& routing_requests) const {
-    router::RouterSettings router_settings {
-        routing_requests.at("bus_wait_time"s).AsInt(),
-        routing_requests.at("bus_velocity"s).AsDouble()
-    };
-    tr_->LoadSettings(router_settings);
+void JsonReader::PrepareMap() {
+    if (!map_renderer_.GetRenderedMap()) {
+        map_renderer_.SetRenderedMap(EncodeMap(map_renderer_, catalogue_));
+    }
 }
     
-string JsonReader::ParseSerializationRequests(const json::Dict& serialization_requests) const {
-    return serialization_requests.at("file"s).AsString();
+void JsonReader::PrintMemoryReport() const {
+    if (!phases_.IsEnabled()) {
+        return;
+    }
+    mem::ComponentUsage total{"total", 0, {catalogue_.GetMemoryUsage()}};
+    if (tr_) {
+        total.parts.push_back(tr_->GetMemoryUsage());
+    }
+    total.parts.push_back(map_renderer_.GetMemoryUsage());
+    mem::PrintUsage(total, phases_.Output());
 }
-
-void JsonReader::ParseStatRequests(const json::Array& stat_requests, ostream& output) const {
-    json::Array queries;
-    for (const auto& request : stat_requests) {
-        json::Dict stat_root = request.AsDict();
-        int id = stat_root.at("id"s).AsInt();
-        string type = stat_root.at("type"s).AsString();
-        if (type == "Stop"s) {
-            const tcat::StopInfo& stop_info = catalogue_.GetStopInfo(stat_root.at("name"s).AsString());
-            queries.push_back(OutputStopInfo(id, stop_info));
-        } else if (type == "Bus"s) {
-            const tcat::BusInfo& bus_info = catalogue_.GetBusInfo(stat_root.at("name"s).AsString());
-            queries.push_back(OutputBusInfo(id, bus_info));
-        } else if (type == "Map"s) {
-            queries.push_back(OutputMap(id));
-        } else if (type == "Route"s) {
-            string from = stat_root.at("from"s).AsString();
-            string to = stat_root.at("to"s).AsString();
-            queries.push_back(OutputRoute(id, from, to));
-        }
-    }
-    json::Print(json::Document{queries}, output);
+    
+void JsonReader::OutputResponse(json::Writer& writer, const StatRequest& request) const {
+    if (request.type == "Stop"s) {
+        OutputStopInfo(writer, request.id, catalogue_.GetStopInfo(*request.name));
+    } else if (request.type == "Bus"s) {
+        OutputBusInfo(writer, request.id, catalogue_.GetBusInfo(*request.name));
+    } else if (request.type == "Map"s) {
+        OutputMap(writer, request.id);
+    } else if (request.type == "Route"s) {
+        OutputRoute(writer, request.id, *request.from, *request.to);
+    }
+}
+    
+serialization::BaseParts JsonReader::GetRequiredBaseParts(const vector<StatRequest>& requests) const {
+    serialization::BaseParts parts{false, false};
+    for (const auto& request : requests) {
+        if (request.type == "Map"s) {
+            parts.render_settings = true;
+        } else if (request.type == "Route"s) {
+            parts.router = true;
+        }
+    }
+    return parts;
 }
     
-json::Node JsonReader::OutputStopInfo(int id, const tcat::StopInfo& stop_info) const {
+// Ключи пишутся в алфавитном порядке, как их печатал json::Dict
+void JsonReader::OutputStopInfo(json::Writer& writer, int id, const tcat::StopInfo& stop_info) const {
     if (stop_info.status == tcat::StopInfoStatus::NOT_FOUND) {
-        return json::Builder{}.StartDict()
-            .Key("request_id"s).Value(id)
-            .Key("error_message"s).Value("not found"s)
-            .EndDict()
-            .Build();
+        writer.StartDict()
+            .Key("error_message"sv).Value("not found"sv)
+            .Key("request_id"sv).Value(id)
+            .EndDict();
     } else {
-        json::Array routes;
+        auto buses = writer.StartDict()
+            .Key("buses"sv).StartArray();
         for (const auto& bus : stop_info.buses) {
-            routes.push_back(json::Node(string(bus)));
+            buses.Value(bus);
         }
-        
-        return json::Builder{}.StartDict()
-            .Key("buses"s).Value(routes)
-            .Key("request_id"s).Value(id)
-            .EndDict()
-            .Build();
+        buses.EndArray()
+            .Key("request_id"sv).Value(id)
+            .EndDict();
     }
 }
     
-json::Node JsonReader::OutputBusInfo(int id, const tcat::BusInfo& bus_info) const {
+void JsonReader::OutputBusInfo(json::Writer& writer, int id, const tcat::BusInfo& bus_info) const {
     if (bus_info.stops == 0) {
-        return json::Builder{}.StartDict()
-            .Key("request_id"s).Value(id)
-            .Key("error_message"s).Value("not found"s)
-            .EndDict()
-            .Build();
-        
+        writer.StartDict()
+            .Key("error_message"sv).Value("not found"sv)
+            .Key("request_id"sv).Value(id)
+            .EndDict();
     } else {
-        return json::Builder{}.StartDict()
-            .Key("curvature"s).Value(bus_info.curvature)
-            .Key("request_id"s).Value(id)
-            .Key("route_length"s).Value(bus_info.route_length)
-            .Key("stop_count"s).Value(bus_info.stops)
-            .Key("unique_stop_count"s).Value(bus_info.unique_stops)
-            .EndDict()
-            .Build();
+        writer.StartDict()
+            .Key("curvature"sv).Value(bus_info.curvature)
+            .Key("request_id"sv).Value(id)
+            .Key("route_length"sv).Value(bus_info.route_length)
+            .Key("stop_count"sv).Value(bus_info.stops)
+            .Key("unique_stop_count"sv).Value(bus_info.unique_stops)
+            .EndDict();
     }
 }
     
-json::Node JsonReader::OutputMap(int id) const {
-    svg::Document map = map_renderer_.RenderMap(catalogue_);
-    ostringstream out;
-    map.Render(out);
-    return json::Builder{}.StartDict()
-        .Key("map"s).Value(out.str())
-        .Key("request_id"s).Value(id)
-        .EndDict()
-        .Build();
+void JsonReader::OutputMap(json::Writer& writer, int id) const {
+    writer.StartDict()
+        .Key("map"sv).Value(json::Encoded{map_renderer_.GetRenderedMap().value()})
+        .Key("request_id"sv).Value(id)
+        .EndDict();
 }
     
-json::Node JsonReader::OutputRoute(int id, const string& from_stop, const string& to_stop) const {
-    //string from = string(from_stop);
-    //string to = string(to_stop);
-    auto route = tr_->CalculateRoute(from_stop, to_stop);
+void JsonReader::OutputRoute(json::Writer& writer, int id, const string& from_stop, const string& to_stop) const {
+    auto route = tr_->FindRoute(from_stop, to_stop);
     if (!route.is_found) {
-        return json::Builder{}.StartDict()
-            .Key("request_id"s).Value(id)
-            .Key("error_message"s).Value("not found"s)
-            .EndDict()
-            .Build();
-    }
-    json::Array items;
-	for (const auto& item : route.items)
-	{
-		json::Dict items_map;
-		if (item.type == graph::EdgeType::TRAVEL)
-		{
-			items_map["type"] = "Bus"s;
-			items_map["bus"] = item.name;
-			items_map["span_count"] = item.span_count;
-		}
-		else if (item.type == graph::EdgeType::WAIT)
-		{
-			items_map["type"] = "Wait"s;
-			items_map["stop_name"] = item.name;
-		}
-		items_map["time"] = item.time;
-		items.push_back(items_map);
-	}
-	return json::Builder{}.StartDict()
-		.Key("request_id").Value(id)
-		.Key("total_time").Value(route.total_time)
-		.Key("items").Value(items)
-		.EndDict()
-		.Build();
+        writer.StartDict()
+            .Key("error_message"sv).Value("not found"sv)
+            .Key("request_id"sv).Value(id)
+            .EndDict();
+        return;
+    }
+    auto items = writer.StartDict()
+        .Key("items"sv).StartArray();
+    for (const auto& item : route.items) {
+        if (item.type == graph::EdgeType::TRAVEL) {
+            items.StartDict()
+                .Key("bus"sv).Value(item.name)
+                .Key("span_count"sv).Value(item.span_count)
+                .Key("time"sv).Value(item.time)
+                .Key("type"sv).Value("Bus"sv)
+                .EndDict();
+        } else if (item.type == graph::EdgeType::WAIT) {
+            items.StartDict()
+                .Key("stop_name"sv).Value(item.name)
+                .Key("time"sv).Value(item.time)
+                .Key("type"sv).Value("Wait"sv)
+                .EndDict();
+        }
+    }
+    items.EndArray()
+        .Key("request_id"sv).Value(id)
+        .Key("total_time"sv).Value(route.total_time)
+        .EndDict();
 }
     
 }
@@ -1,41 +1,94 @@
 #pragma once
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include "json.h"
+#include "json_writer.h"
 #include "transport_catalogue.h"
 #include "domain.h"
 #include "map_renderer.h"
 #include "transport_router.h"
+#include "memory_report.h"
+#include "serialization.h"
 
 namespace io {
+    
+// Запрос к загруженной базе; name для Stop и Bus, from и to для Route. Разобранный запрос
+// уже проверен: поля, нужные его типу, заданы
+struct StatRequest {
+    int id = 0;
+    std::string type;
+    std::optional<std::string> name;
+    std::optional<std::string> from;
+    std::optional<std::string> to;
+};
+    
+// Ошибка в одном пакете serve: разбор или ответ не удался, но загруженная база не тронута
+class BatchError : public std::runtime_error {
+public:
+    using runtime_error::runtime_error;
+};
+    
 class JsonReader {
 public:
     JsonReader(tcat::TransportCatalogue& catalogue, map_r::MapRenderer& map_renderer_);
     void LoadBaseQueries(std::istream& input);
     void LoadStatQueries(std::istream& input, std::ostream& output);
+    // Печатает пиковый RSS после каждой фазы и итоговый расход памяти по компонентам
+    void EnableMemoryReport(std::ostream& report_output);
+    // Отвечает на stat_requests по мере чтения, не собирая ни запросы, ни ответы в документ
+    void EnableStreaming();
+    // Ответы печатаются без отступов и переводов строк
+    void EnableCompactOutput();
+    // При нескольких потоках вход make_base читается целиком, и элементы base_requests
+    // разбираются параллельно, а ответы process_requests без потокового режима готовятся
+    // сразу на всех потоках и выводятся в порядке запросов; при одном всё идёт по очереди
+    void SetThreadCount(size_t threads);
+    // Отвечает на один документ process_requests в режиме serve. База целиком загружается
+    // при первом пакете с serialization_settings, и маршрутизатор строится сразу; дальше
+    // настройки можно опускать, а другая база — ошибка пакета. Если база не загрузилась, это тоже
+    // BatchError, и следующий пакет с serialization_settings загружает её заново. После BatchError
+    // вывод пакета надо отбросить
+    void AnswerBatch(std::string_view input, std::ostream& output);
 private:
-    void ParseBaseRequests(const json::Array& base_requests) const;
-    void ParseRenderRequests(const json::Dict& render_requests) const;
-    void ParseRoutingRequests(const json::Dict& routing_requests) const;
-    std::string ParseSerializationRequests(const json::Dict& serialization_requests) const;
+    void StreamStatQueries(std::istream& input, std::ostream& output);
+    void LoadBase(const serialization::SerializationSettings& serialization_settings, serialization::BaseParts parts);
+    // Пишет новую базу: граф, карта и справочник кодируются одновременно на разных потоках,
+    // а файл записывается, когда готовы все секции
+    void SaveBase(const serialization::SerializationSettings& serialization_settings, bool prerender_map);
+    // Рисует карту, если её нет в базе; дальше ответы на Map только копируют готовую строку
+    void PrepareMap();
+    // Какие части базы нужны для ответа на запросы
+    serialization::BaseParts GetRequiredBaseParts(const std::vector<StatRequest>& requests) const;
+    // На запросы неизвестного типа ничего не пишется
+    void OutputResponse(json::Writer& writer, const StatRequest& request) const;
+    // Весь массив ответов, на нескольких потоках, если запросов много
+    void OutputResponses(const std::vector<StatRequest>& requests, std::ostream& output) const;
+    // Справочник, маршрутизатор и рендерер к этому моменту только читаются
+    void OutputResponsesInParallel(const std::vector<StatRequest>& requests, std::ostream& output) const;
     
-    void ParseStatRequests(const json::Array& stat_requests, std::ostream& output) const;
+    void OutputStopInfo(json::Writer& writer, int id, const tcat::StopInfo& stop_info) const;
+    void OutputBusInfo(json::Writer& writer, int id, const tcat::BusInfo& bus_info) const;
+    // Карта к этому моменту готова, см. PrepareMap
+    void OutputMap(json::Writer& writer, int id) const;
+    void OutputRoute(json::Writer& writer, int id, const std::string& from_stop, const std::string& to_stop) const;
     
-    tcat::Stop ParseStop(const json::Dict& dict) const;
-    tcat::PreBus ParsePreBus(const json::Dict& dict) const;
-    tcat::StopDistances ParseStopDistances(const json::Dict& dict) const;
-    svg::Color ParseColorData(const json::Node& color) const;
-    json::Node OutputStopInfo(int id, const tcat::StopInfo& stop_info) const;
-    json::Node OutputBusInfo(int id, const tcat::BusInfo& bus_info) const;
-    json::Node OutputMap(int id) const;
-    json::Node OutputRoute(int id, const std::string& from_stop, const std::string& to_stop) const;
+    void PrintMemoryReport() const;
     
     
-    json::Document doc_{nullptr};
     tcat::TransportCatalogue& catalogue_;
     map_r::MapRenderer& map_renderer_;
     std::shared_ptr<router::TransportRouter> tr_ = nullptr;
+    mem::PhaseTracker phases_;
+    bool streaming_ = false;
+    size_t threads_ = 1;
+    json::Writer::Style output_style_ = json::Writer::Style::PRETTY;
+    // Настройки базы, загруженной в режиме serve
+    std::optional<serialization::SerializationSettings> served_settings_;
 };
 }
@@ -0,0 +1,104 @@
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "transport_catalogue.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+int failures = 0;
+
+// Справочник в виде текста: остановки и автобусы по порядку id, расстояния по именам
+string DumpCatalogue(const tcat::TransportCatalogue& catalogue) {
+    ostringstream dump;
+    dump.precision(17);
+    for (const tcat::Stop& stop : catalogue.GetAllStops()) {
+        const geo::Coordinates coords = geo::ToCoordinates(stop.coordinates);
+        dump << "stop " << stop.id << ' ' << stop.name << ' ' << coords.lat << ' ' << coords.lng << '\n';
+    }
+    for (const tcat::Bus& bus : catalogue.GetAllBuses()) {
+        dump << "bus " << bus.id << ' ' << bus.name << (bus.is_circular ? " circular" : " linear");
+        for (const tcat::Stop* stop : bus.stops) {
+            dump << " [" << stop->name << ']';
+        }
+        dump << ' ' << bus.route_length << ' ' << bus.curvature << '\n';
+    }
+    vector<string> distances;
+    for (const auto& [stops, distance] : catalogue.GetAllDistances()) {
+        distances.push_back("distance " + stops.first->name + " -> " + stops.second->name + ' ' + to_string(distance));
+    }
+    sort(distances.begin(), distances.end());
+    for (const string& distance : distances) {
+        dump << distance << '\n';
+    }
+    return dump.str();
+}
+
+// Справочник или текст ошибки, если make_base не разобрал документ
+string LoadCatalogue(const string& document, size_t threads) {
+    tcat::TransportCatalogue catalogue;
+    map_r::MapRenderer map_renderer;
+    io::JsonReader reader(catalogue, map_renderer);
+    reader.SetThreadCount(threads);
+    istringstream input(document);
+    try {
+        reader.LoadBaseQueries(input);
+    } catch (const exception& e) {
+        return "error: "s + e.what();
+    }
+    return DumpCatalogue(catalogue);
+}
+
+void CheckSameCatalogue(const string& name, const string& base_requests, bool is_valid = true) {
+    const string document = R"({"base_requests": [)" + base_requests + "]}";
+    const string serial = LoadCatalogue(document, 1);
+    if (is_valid == (serial.rfind("error: ", 0) == 0)) {
+        cerr << name << ": serial parse " << (is_valid ? "failed: " : "succeeded:\n") << serial << '\n';
+        ++failures;
+    }
+    for (size_t threads : {2, 3, 4, 8}) {
+        const string parallel = LoadCatalogue(document, threads);
+        if (parallel != serial) {
+            cerr << name << ", " << threads << " threads:\n" << parallel << "instead of\n" << serial << '\n';
+            ++failures;
+        }
+    }
+}
+} // namespace
+
+int main() {
+    const string a = R"({"type": "Stop", "name": "A", "latitude": 55.6, "longitude": 37.2, "road_distances": {"B": 3900}})";
+    const string b = R"({"type": "Stop", "name": "B", "latitude": 55.59, "longitude": 37.21, "road_distances": {"C": 1200}})";
+    const string c = R"({"type": "Stop", "name": "C", "latitude": 55.61, "longitude": 37.22, "road_distances": {"A": 700}})";
+    const string bus = R"({"type": "Bus", "name": "1", "stops": ["A", "B", "C", "A"], "is_roundtrip": true})";
+    const string line = R"({"is_roundtrip": false, "stops": ["C", "B"], "name": "2 \"x\" , {", "type": "Bus"})";
+
+    CheckSameCatalogue("commas", a + ", " + b + ",\n" + c + "," + bus + ", " + line);
+    CheckSameCatalogue("single element", R"({"type": "Stop", "name": "D", "latitude": 0, "longitude": 0})");
+    CheckSameCatalogue("empty array", "");
+    // Разбор массива не требует запятых, и элемент без запятой не должен пропадать
+    CheckSameCatalogue("no commas", a + " " + b + "\n" + c + " " + bus + line);
+    CheckSameCatalogue("some commas", a + b + ", " + c + bus + " , " + line);
+    CheckSameCatalogue("leading comma", ", " + a + ", " + b + ", " + c + ", " + bus);
+    CheckSameCatalogue("nested values", bus + R"({"a": [3, {"b": []}], "type": "Other"})" + a + b + c);
+    // После элемента осталось ещё одно значение — оно тоже элемент, а не хвост предыдущего
+    CheckSameCatalogue("scalar after element", a + " 5, " + b + c + bus, false);
+    CheckSameCatalogue("string after element", a + R"( "x")" + b + c + bus, false);
+    CheckSameCatalogue("number without comma", a + ", 1 2, " + b + c + bus, false);
+    CheckSameCatalogue("key in array", a + R"(, "B": )" + b + c + bus, false);
+    CheckSameCatalogue("trailing comma", a + ", " + b + ", " + c + ", " + bus + ",", false);
+    CheckSameCatalogue("double comma", a + ",, " + b + c + bus, false);
+
+    if (failures > 0) {
+        cerr << failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    cout << "json_reader_test OK\n";
+}
@@ -0,0 +1,236 @@
+#include "json_writer.h"
+#include "number_format.h"
+#include "text_scan.h"
+
+#include <stdexcept>
+#include <variant>
+
+using namespace std;
+
+namespace json {
+
+Writer::Writer(string& buffer, Style style)
+    : buffer_(buffer)
+    , style_(style) {
+}
+
+Writer Writer::ArrayItems(string& buffer, Style style, bool has_items) {
+    Writer writer(buffer, style);
+    writer.depth_ = 1;
+    writer.arrays_ = 1;
+    writer.has_items_ = has_items ? 1 : 0;
+    writer.complete_ = true;
+    return writer;
+}
+
+Writer::KeyItemContext Writer::Key(string_view key) {
+    if (depth_ == 0 || InArray() || key_opened_) {
+        throw logic_error("Key used outside Dict"s);
+    }
+    BeginItem();
+    WriteString(key);
+    buffer_ += style_ == Style::PRETTY ? ": "sv : ":"sv;
+    key_opened_ = true;
+    return *this;
+}
+
+Writer::BaseContext Writer::Value(nullptr_t) {
+    BeginValue();
+    buffer_ += "null"sv;
+    return *this;
+}
+
+Writer::BaseContext Writer::Value(bool value) {
+    BeginValue();
+    buffer_ += value ? "true"sv : "false"sv;
+    return *this;
+}
+
+Writer::BaseContext Writer::Value(int value) {
+    BeginValue();
+    num::Append(buffer_, value);
+    return *this;
+}
+
+Writer::BaseContext Writer::Value(double value) {
+    BeginValue();
+    num::Append(buffer_, value);
+    return *this;
+}
+
+Writer::BaseContext Writer::Value(string_view value) {
+    BeginValue();
+    WriteString(value);
+    return *this;
+}
+
+Writer::BaseContext Writer::Value(const string& value) {
+    return Value(string_view(value));
+}
+
+Writer::BaseContext Writer::Value(const char* value) {
+    return Value(string_view(value));
+}
+
+Writer::BaseContext Writer::Value(Encoded value) {
+    BeginValue();
+    buffer_ += value.json;
+    return *this;
+}
+
+Writer::BaseContext Writer::Value(const Node& value) {
+    if (value.IsArray()) {
+        StartArray();
+        for (const Node& item : value.AsArray()) {
+            Value(item);
+        }
+        EndArray();
+    } else if (value.IsDict()) {
+        StartDict();
+        for (const auto& [key, item] : value.AsDict()) {
+            Key(key);
+            Value(item);
+        }
+        EndDict();
+    } else {
+        visit([this](const auto& scalar) {
+            using Scalar = decay_t<decltype(scalar)>;
+            if constexpr (is_same_v<Scalar, String>) {
+                Value(string_view(scalar));
+            } else if constexpr (!is_same_v<Scalar, Array> && !is_same_v<Scalar, Dict>) {
+                Value(scalar);
+            }
+        }, value.GetValue());
+    }
+    return *this;
+}
+
+Writer::DictItemContext Writer::StartDict() {
+    Open(false);
+    return *this;
+}
+
+Writer::ArrayItemContext Writer::StartArray() {
+    Open(true);
+    return *this;
+}
+
+Writer::BaseContext Writer::EndDict() {
+    if (depth_ == 0 || InArray() || key_opened_) {
+        throw logic_error("Cannot EndDict() a non-Dict object"s);
+    }
+    Close(false);
+    return *this;
+}
+
+Writer::BaseContext Writer::EndArray() {
+    if (depth_ == 0 || !InArray()) {
+        throw logic_error("Cannot EndArray() a non-Array object"s);
+    }
+    Close(true);
+    return *this;
+}
+
+void Writer::BeginValue() {
+    if (depth_ == 0) {
+        if (complete_) {
+            throw logic_error("Cannot add value outside of Dict or Array"s);
+        }
+        complete_ = true;
+    } else if (InArray()) {
+        BeginItem();
+    } else if (key_opened_) {
+        key_opened_ = false;
+    } else {
+        throw logic_error("No key was opened"s);
+    }
+}
+
+bool Writer::InArray() const {
+    return (arrays_ >> (depth_ - 1)) & 1;
+}
+
+void Writer::BeginItem() {
+    const uint64_t bit = uint64_t{1} << (depth_ - 1);
+    if (has_items_ & bit) {
+        buffer_ += style_ == Style::PRETTY ? ",\n"sv : ","sv;
+    }
+    has_items_ |= bit;
+    WriteIndent();
+}
+
+void Writer::Open(bool is_array) {
+    BeginValue();
+    if (depth_ == MAX_DEPTH) {
+        throw logic_error("JSON nesting is too deep"s);
+    }
+    const uint64_t bit = uint64_t{1} << depth_++;
+    arrays_ = is_array ? arrays_ | bit : arrays_ & ~bit;
+    has_items_ &= ~bit;
+    buffer_ += is_array ? '[' : '{';
+    if (style_ == Style::PRETTY) {
+        buffer_ += '\n';
+    }
+}
+
+void Writer::Close(bool is_array) {
+    --depth_;
+    if (style_ == Style::PRETTY) {
+        buffer_ += '\n';
+        WriteIndent();
+    }
+    buffer_ += is_array ? ']' : '}';
+}
+
+void Writer::WriteIndent() {
+    if (style_ == Style::PRETTY) {
+        buffer_.append(static_cast<size_t>(depth_) * 4, ' ');
+    }
+}
+
+void Writer::WriteString(string_view value) {
+    buffer_ += '"';
+    const char* pos = value.data();
+    const char* const end = pos + value.size();
+    while (true) {
+        // Участок без особых символов дописывается целиком
+        const char* special = scan::FindJsonSpecial(pos, end);
+        buffer_.append(pos, special);
+        if (special == end) {
+            break;
+        }
+        pos = special + 1;
+        switch (*special) {
+            case '\r':
+                buffer_ += "\\r"sv;
+                break;
+            case '\n':
+                buffer_ += "\\n"sv;
+                break;
+            default:
+                // Символы " и \ выводятся как \" или \\, соответственно
+                buffer_ += '\\';
+                buffer_ += *special;
+                break;
+        }
+    }
+    buffer_ += '"';
+}
+
+Writer::KeyItemContext Writer::BaseContext::Key(string_view key) {
+    return writer_.Key(key);
+}
+Writer::DictItemContext Writer::BaseContext::StartDict() {
+    return writer_.StartDict();
+}
+Writer::ArrayItemContext Writer::BaseContext::StartArray() {
+    return writer_.StartArray();
+}
+Writer::BaseContext Writer::BaseContext::EndDict() {
+    return writer_.EndDict();
+}
+Writer::BaseContext Writer::BaseContext::EndArray() {
+    return writer_.EndArray();
+}
+
+} // namespace json
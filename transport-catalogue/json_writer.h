@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "json.h"
+
+namespace json {
+
+// Значение, уже записанное в JSON; Writer вставляет его как есть
+struct Encoded {
+    std::string_view json;
+};
+
+// Пишет JSON сразу в buffer, не строя узлов; буфер опустошает владелец. Ключи выводятся
+// в порядке вызовов Key. Отступы в режиме PRETTY те же, что у Print, в COMPACT пробелов нет
+class Writer {
+public:
+    class BaseContext;
+    class KeyItemContext;
+    class DictItemContext;
+    class ArrayItemContext;
+
+    enum class Style {
+        PRETTY,
+        COMPACT
+    };
+
+    explicit Writer(std::string& buffer, Style style = Style::PRETTY);
+    // Продолжает корневой массив, открытый другим Writer: значения пишутся его элементами,
+    // с теми же отступами и запятыми, как если бы до них в нём было has_items элементов.
+    // Так части одного массива можно готовить в разных буферах и склеить по порядку
+    static Writer ArrayItems(std::string& buffer, Style style, bool has_items);
+
+    KeyItemContext Key(std::string_view key);
+    BaseContext Value(std::nullptr_t);
+    BaseContext Value(bool value);
+    BaseContext Value(int value);
+    BaseContext Value(double value);
+    BaseContext Value(std::string_view value);
+    BaseContext Value(const std::string& value);
+    BaseContext Value(const char* value);
+    BaseContext Value(Encoded value);
+    // Узел печатается целиком, с ключами словарей по порядку
+    BaseContext Value(const Node& value);
+    DictItemContext StartDict();
+    ArrayItemContext StartArray();
+    BaseContext EndDict();
+    BaseContext EndArray();
+
+private:
+    // Вложенность хранится битами: бит уровня в arrays_ отмечает массив,
+    // в has_items_ — что в контейнер уже что-то записано
+    static constexpr int MAX_DEPTH = 64;
+
+    std::string& buffer_;
+    Style style_;
+    int depth_ = 0;
+    uint64_t arrays_ = 0;
+    uint64_t has_items_ = 0;
+    bool key_opened_ = false;
+    bool complete_ = false;
+
+    // Вызывается только при открытом контейнере
+    bool InArray() const;
+    void BeginValue();
+    void BeginItem();
+    void Open(bool is_array);
+    void Close(bool is_array);
+    void WriteIndent();
+    void WriteString(std::string_view value);
+};
+
+class Writer::BaseContext {
+public:
+    BaseContext(Writer& writer) : writer_(writer) {}
+
+    KeyItemContext Key(std::string_view key);
+    template <typename T>
+    BaseContext Value(T&& value) {
+        return writer_.Value(std::forward<T>(value));
+    }
+    DictItemContext StartDict();
+    ArrayItemContext StartArray();
+    BaseContext EndDict();
+    BaseContext EndArray();
+
+protected:
+    Writer& writer_;
+};
+
+class Writer::KeyItemContext : private BaseContext {
+public:
+    KeyItemContext(Writer& writer) : BaseContext(writer) {}
+
+    template <typename T>
+    DictItemContext Value(T&& value);
+    using BaseContext::StartDict;
+    using BaseContext::StartArray;
+};
+
+class Writer::DictItemContext : private BaseContext {
+public:
+    DictItemContext(Writer& writer) : BaseContext(writer) {}
+
+    using BaseContext::Key;
+    using BaseContext::EndDict;
+};
+
+class Writer::ArrayItemContext : private BaseContext {
+public:
+    ArrayItemContext(Writer& writer) : BaseContext(writer) {}
+
+    template <typename T>
+    ArrayItemContext Value(T&& value) {
+        writer_.Value(std::forward<T>(value));
+        return writer_;
+    }
+    using BaseContext::StartDict;
+    using BaseContext::StartArray;
+    using BaseContext::EndArray;
+};
+
+template <typename T>
+Writer::DictItemContext Writer::KeyItemContext::Value(T&& value) {
+    writer_.Value(std::forward<T>(value));
+    return writer_;
+}
+
+} // namespace json
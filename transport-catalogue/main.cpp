@@ -1,37 +1,123 @@
 #include "map_renderer.h"
 #include "transport_catalogue.h"
 #include "json_reader.h"
+#include "server.h"
 
+#include <algorithm>
+#include <charconv>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <string>
 #include <string_view>
+#include <thread>
 
 using namespace std::literals;
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+    stream << "Usage: transport_catalogue [make_base|process_requests] [--memory-report] [--stream] [--compact] [--threads N]\n"sv
+           << "       transport_catalogue serve [--socket PATH] [--lines] [--memory-report] [--compact] [--threads N]\n"sv
+           << "       transport_catalogue client --socket PATH [--lines]\n"sv;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
+    if (argc < 2) {
         PrintUsage();
         return 1;
     }
 
     const std::string_view mode(argv[1]);
+    bool memory_report = false;
+    bool streaming = false;
+    bool compact = false;
+    // serve и client: Unix-сокет вместо stdin и stdout, документы по строке вместо длины перед документом
+    std::string socket_path;
+    server::Framing framing = server::Framing::LENGTH;
+    // По умолчанию base_requests разбираются, а ответы готовятся на всех ядрах
+    size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+    const bool serves = mode == "serve"sv || mode == "client"sv;
+    for (int i = 2; i < argc; ++i) {
+        if (argv[i] == "--memory-report"sv && mode != "client"sv) {
+            memory_report = true;
+        } else if (argv[i] == "--stream"sv && mode == "process_requests"sv) {
+            streaming = true;
+        } else if (argv[i] == "--compact"sv && (mode == "process_requests"sv || mode == "serve"sv)) {
+            compact = true;
+        } else if (argv[i] == "--socket"sv && serves && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (argv[i] == "--lines"sv && serves) {
+            framing = server::Framing::LINES;
+        } else if (argv[i] == "--threads"sv && mode != "client"sv && i + 1 < argc) {
+            const std::string_view value(argv[++i]);
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), threads);
+            if (error != std::errc() || end != value.data() + value.size() || threads == 0) {
+                PrintUsage();
+                return 1;
+            }
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    // Без синхронизации с stdio std::cin буферизует ввод сам и отдаёт парсеру уже прочитанное
+    std::ios::sync_with_stdio(false);
     
     if (mode == "make_base"sv) {
 	tcat::TransportCatalogue catalogue;
     	map_r::MapRenderer map_renderer;
     	io::JsonReader reader(catalogue, map_renderer);
+        if (memory_report) {
+            reader.EnableMemoryReport(std::cerr);
+        }
+        reader.SetThreadCount(threads);
 
         reader.LoadBaseQueries(std::cin);
     } else if (mode == "process_requests"sv) {
 	tcat::TransportCatalogue catalogue;
     	map_r::MapRenderer map_renderer;
     	io::JsonReader reader(catalogue, map_renderer);
+        if (memory_report) {
+            reader.EnableMemoryReport(std::cerr);
+        }
+        if (streaming) {
+            reader.EnableStreaming();
+        }
+        if (compact) {
+            reader.EnableCompactOutput();
+        }
+        reader.SetThreadCount(threads);
 
         reader.LoadStatQueries(std::cin, std::cout);
+    } else if (mode == "serve"sv) {
+	tcat::TransportCatalogue catalogue;
+    	map_r::MapRenderer map_renderer;
+    	io::JsonReader reader(catalogue, map_renderer);
+        if (memory_report) {
+            reader.EnableMemoryReport(std::cerr);
+        }
+        // Ответ на пакет занимает одну строку
+        if (compact || framing == server::Framing::LINES) {
+            reader.EnableCompactOutput();
+        }
+        reader.SetThreadCount(threads);
+
+        try {
+            if (socket_path.empty()) {
+                server::ServeStdio(reader, framing);
+            } else {
+                server::ServeSocket(reader, framing, socket_path);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+    } else if (mode == "client"sv && !socket_path.empty()) {
+        try {
+            server::SendBatch(socket_path, framing, std::cin, std::cout);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
     } else {
         PrintUsage();
         return 1;
@@ -7,6 +7,7 @@
 #include <memory>
 #include <map>
 #include <unordered_set>
+#include <iterator>
 
 #include "map_renderer.h"
 #include "transport_catalogue.h"
@@ -26,6 +27,10 @@ svg::Point SphereProjector::operator()(geo::Coordinates coords) const {
         };
 }
     
+svg::Point SphereProjector::operator()(geo::CompactCoordinates coords) const {
+    return (*this)(geo::FromCompact(coords));
+}
+    
 BusRoute::BusRoute(vector<svg::Point>& stops, const svg::Color& color, const RenderSettings& settings) :
     stops_(stops), color_(color), settings_(settings) {}
     
@@ -104,82 +109,105 @@ void StopName::Draw(svg::ObjectContainer& container) const {
 
 void MapRenderer::LoadSettings(RenderSettings settings) {
     settings_ = move(settings);
+    rendered_map_.reset();
 }
     
 const RenderSettings& MapRenderer::GetSettings() const {
     return settings_;
 }
+    
+void MapRenderer::SetRenderedMap(string map_json) {
+    rendered_map_ = move(map_json);
+}
+    
+const optional<string>& MapRenderer::GetRenderedMap() const {
+    return rendered_map_;
+}
   
-void MapRenderer::MakeBusRoutes(const map<string, tcat::RenderData>& bus_to_stop_coords, vector<unique_ptr<svg::Drawable>>& picture) {
+void MapRenderer::MakeBusRoutes(const map<string, tcat::RenderData>& bus_to_stop_coords, const SphereProjector& sp,
+                                vector<unique_ptr<svg::Drawable>>& picture) const {
+    size_t bus_index = 0;
     for (const auto& [bus_name, render_data] : bus_to_stop_coords) {
         vector<svg::Point> points;
         for (const auto& stop : render_data.stop_coords) {
-            points.push_back(sp_(stop));
+            points.push_back(sp(stop));
+        }
+        if (!render_data.is_circular) {
+            for (auto it = next(render_data.stop_coords.rbegin()); it != render_data.stop_coords.rend(); ++it) {
+                points.push_back(sp(*it));
+            }
         }
-        picture.push_back(make_unique<BusRoute>(points, GetCurrentColor(), settings_));
+        picture.push_back(make_unique<BusRoute>(points, GetBusColor(bus_index++), settings_));
     }
 }
     
-void MapRenderer::MakeBusNames(const map<string, tcat::RenderData>& bus_to_stop_coords,
-                              vector<unique_ptr<svg::Drawable>>& picture) {
-    ResetCurrentColor();
+void MapRenderer::MakeBusNames(const map<string, tcat::RenderData>& bus_to_stop_coords, const SphereProjector& sp,
+                              vector<unique_ptr<svg::Drawable>>& picture) const {
+    size_t bus_index = 0;
     for (const auto& [bus_name, render_data] : bus_to_stop_coords) {
-        svg::Point bus_name_pos = sp_(render_data.stop_coords.at(0));
-        svg::Color current_color = GetCurrentColor();
+        svg::Point bus_name_pos = sp(render_data.stop_coords.at(0));
+        svg::Color current_color = GetBusColor(bus_index++);
         picture.push_back(make_unique<BusName>(bus_name_pos, bus_name, current_color, settings_));
-        if (!render_data.is_circular && 
-            render_data.stop_coords.at(0) != render_data.stop_coords.at((render_data.stop_coords.size() + 1) / 2 - 1)) {
-            svg::Point bus_name_end_pos = sp_(render_data.stop_coords.at((render_data.stop_coords.size() + 1) / 2 - 1)); 
+        if (!render_data.is_circular && render_data.stop_coords.at(0) != render_data.stop_coords.back()) {
+            svg::Point bus_name_end_pos = sp(render_data.stop_coords.back()); 
             picture.push_back(make_unique<BusName>(bus_name_end_pos, bus_name, current_color, settings_));
         }
     }
 }
     
-void MapRenderer::MakeStopSymbols(const map<string, geo::Coordinates>& unique_stops, 
-                                 vector<unique_ptr<svg::Drawable>>& picture) {
+void MapRenderer::MakeStopSymbols(const map<string, geo::StoredCoordinates>& unique_stops, const SphereProjector& sp,
+                                 vector<unique_ptr<svg::Drawable>>& picture) const {
     for (const auto& [_, coords] : unique_stops) {
-        picture.push_back(make_unique<StopSymbol>(sp_(coords), settings_));
+        picture.push_back(make_unique<StopSymbol>(sp(coords), settings_));
     }
 }
     
-void MapRenderer::MakeStopNames(const map<string, geo::Coordinates>& unique_stops,
-                               vector<unique_ptr<svg::Drawable>>& picture) {
+void MapRenderer::MakeStopNames(const map<string, geo::StoredCoordinates>& unique_stops, const SphereProjector& sp,
+                               vector<unique_ptr<svg::Drawable>>& picture) const {
     for (const auto& [stop_name, coords] : unique_stops) {
-        picture.push_back(make_unique<StopName>(sp_(coords), stop_name, settings_));
+        picture.push_back(make_unique<StopName>(sp(coords), stop_name, settings_));
     }
 }
     
-const svg::Color MapRenderer::GetCurrentColor() {
-    if (current_color_ == settings_.color_palette.size()) {
-        current_color_ = 0;
+mem::ComponentUsage MapRenderer::GetMemoryUsage() const {
+    mem::ComponentUsage palette{"color palette", mem::VectorBytes(settings_.color_palette), {}};
+    for (const svg::Color& color : settings_.color_palette) {
+        if (holds_alternative<string>(color)) {
+            palette.bytes += mem::StringBytes(get<string>(color));
+        }
     }
-    return settings_.color_palette.at(current_color_++);
+    mem::ComponentUsage rendered_map{"rendered map", rendered_map_ ? mem::StringBytes(*rendered_map_) : 0, {}};
+    return {"map renderer", sizeof(*this), {move(palette), move(rendered_map)}};
 }
     
-void MapRenderer::ResetCurrentColor() {
-    current_color_ = 0;
+const svg::Color& MapRenderer::GetBusColor(size_t bus_index) const {
+    const vector<svg::Color>& palette = settings_.color_palette;
+    return palette.at(palette.empty() ? 0 : bus_index % palette.size());
 }
     
-svg::Document MapRenderer::RenderMap(const tcat::TransportCatalogue& catalogue) {
+svg::Document MapRenderer::RenderMap(const tcat::TransportCatalogue& catalogue) const {
     const map<string, tcat::RenderData>& bus_to_stop_coords = catalogue.GetAllRoutes();
-    unordered_set<geo::Coordinates, geo::CoordinatesHasher> all_coords;
-    map<string, geo::Coordinates> unique_stops;
+    unordered_set<geo::StoredCoordinates, geo::StoredCoordinatesHasher> all_coords;
+    map<string, geo::StoredCoordinates> unique_stops;
     for (const auto& [bus_name, render_data] : bus_to_stop_coords) {
         for (size_t i = 0; i < render_data.stop_coords.size(); ++i) {
             all_coords.insert(render_data.stop_coords.at(i));
             unique_stops[render_data.stop_names.at(i)] = render_data.stop_coords.at(i);
         }
     }
-    SphereProjector sp {all_coords.begin(), all_coords.end(),
+    vector<geo::Coordinates> projected_coords;
+    projected_coords.reserve(all_coords.size());
+    for (const auto& coords : all_coords) {
+        projected_coords.push_back(geo::ToCoordinates(coords));
+    }
+    SphereProjector sp {projected_coords.begin(), projected_coords.end(),
                        settings_.width, settings_.height, settings_.padding};
-    sp_ = move(sp);
-    
     vector<unique_ptr<svg::Drawable>> picture;
     
-    MakeBusRoutes(bus_to_stop_coords, picture);
-    MakeBusNames(bus_to_stop_coords, picture);
-    MakeStopSymbols(unique_stops, picture);
-    MakeStopNames(unique_stops, picture);
+    MakeBusRoutes(bus_to_stop_coords, sp, picture);
+    MakeBusNames(bus_to_stop_coords, sp, picture);
+    MakeStopSymbols(unique_stops, sp, picture);
+    MakeStopNames(unique_stops, sp, picture);
     
     svg::Document doc;
     DrawPicture(picture, doc);
@@ -13,6 +13,7 @@
 #include "geo.h"
 #include "svg.h"
 #include "transport_catalogue.h"
+#include "memory_report.h"
 
 namespace map_r {
     
@@ -90,6 +91,7 @@ public:
 
     // Проецирует широту и долготу в координаты внутри SVG-изображения
     svg::Point operator()(geo::Coordinates coords) const;
+    svg::Point operator()(geo::CompactCoordinates coords) const;
 
 private:
     double padding_;
@@ -142,21 +144,29 @@ class MapRenderer {
 public:
     MapRenderer() = default;
     
+    // Сбрасывает готовую карту
     void LoadSettings(RenderSettings settings);
     const RenderSettings& GetSettings() const;
-    void MakeBusRoutes(const std::map<std::string, tcat::RenderData>& bus_to_stop_coords,
-                        std::vector<std::unique_ptr<svg::Drawable>>& picture);
-    void MakeBusNames(const std::map<std::string, tcat::RenderData>& bus_to_stop_coords,
-                        std::vector<std::unique_ptr<svg::Drawable>>& picture);
-    void MakeStopSymbols(const std::map<std::string, geo::Coordinates>& unique_stops, 
-                        std::vector<std::unique_ptr<svg::Drawable>>& picture);
-    void MakeStopNames(const std::map<std::string, geo::Coordinates>& unique_stops, 
-                        std::vector<std::unique_ptr<svg::Drawable>>& picture);
+    // Готовая карта, уже закодированная строкой JSON. Справочник и настройки после загрузки
+    // не меняются, так что карту достаточно отрисовать один раз или взять из базы
+    void SetRenderedMap(std::string map_json);
+    const std::optional<std::string>& GetRenderedMap() const;
+    void MakeBusRoutes(const std::map<std::string, tcat::RenderData>& bus_to_stop_coords, const SphereProjector& sp,
+                        std::vector<std::unique_ptr<svg::Drawable>>& picture) const;
+    void MakeBusNames(const std::map<std::string, tcat::RenderData>& bus_to_stop_coords, const SphereProjector& sp,
+                        std::vector<std::unique_ptr<svg::Drawable>>& picture) const;
+    void MakeStopSymbols(const std::map<std::string, geo::StoredCoordinates>& unique_stops, const SphereProjector& sp,
+                        std::vector<std::unique_ptr<svg::Drawable>>& picture) const;
+    void MakeStopNames(const std::map<std::string, geo::StoredCoordinates>& unique_stops, const SphereProjector& sp,
+                        std::vector<std::unique_ptr<svg::Drawable>>& picture) const;
     
-    svg::Document RenderMap(const tcat::TransportCatalogue& catalogue);
+    // Не меняет рендерер, так что карту можно рисовать из нескольких потоков сразу
+    svg::Document RenderMap(const tcat::TransportCatalogue& catalogue) const;
+    
+    mem::ComponentUsage GetMemoryUsage() const;
     
     template <typename DrawableIterator>
-    void DrawPicture(DrawableIterator begin, DrawableIterator end, svg::ObjectContainer& target)
+    void DrawPicture(DrawableIterator begin, DrawableIterator end, svg::ObjectContainer& target) const
     {
         for (auto it = begin; it != end; ++it)
         {
@@ -165,16 +175,15 @@ public:
     }
 
     template <typename Container>
-    void DrawPicture(const Container& container, svg::ObjectContainer& target)
+    void DrawPicture(const Container& container, svg::ObjectContainer& target) const
     {
         DrawPicture(begin(container), end(container), target);
     }
     
 private:
-    uint32_t current_color_ = 0;
-    const svg::Color GetCurrentColor();
-    void ResetCurrentColor();
+    // Цвета палитры идут по кругу в порядке маршрутов
+    const svg::Color& GetBusColor(size_t bus_index) const;
     RenderSettings settings_;
-    SphereProjector sp_;
+    std::optional<std::string> rendered_map_;
 };
 }
\ No newline at end of file
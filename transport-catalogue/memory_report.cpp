@@ -0,0 +1,64 @@
+#include "memory_report.h"
+
+#include <sys/resource.h>
+
+#include <iomanip>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace mem {
+    
+namespace {
+void PrintUsage(const ComponentUsage& usage, ostream& out, int indent) {
+    out << string(indent, ' ') << left << setw(40 - indent) << usage.name
+        << right << setw(14) << usage.Total() << " B\n"s;
+    for (const ComponentUsage& part : usage.parts) {
+        PrintUsage(part, out, indent + 2);
+    }
+}
+}
+    
+size_t ComponentUsage::Total() const {
+    size_t result = bytes;
+    for (const ComponentUsage& part : parts) {
+        result += part.Total();
+    }
+    return result;
+}
+    
+void PrintUsage(const ComponentUsage& usage, ostream& out) {
+    PrintUsage(usage, out, 0);
+}
+    
+size_t GetPeakRss() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    // ru_maxrss в Linux измеряется в килобайтах
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+    
+PhaseTracker::PhaseTracker(ostream& out) : out_(&out) {}
+    
+void PhaseTracker::Mark(string_view phase) const {
+    if (out_) {
+        *out_ << "peak RSS after "sv << left << setw(26) << phase
+              << right << setw(14) << GetPeakRss() << " B\n"sv;
+    }
+}
+    
+bool PhaseTracker::IsEnabled() const {
+    return out_ != nullptr;
+}
+    
+ostream& PhaseTracker::Output() const {
+    return *out_;
+}
+    
+size_t StringBytes(const string& str) {
+    static const size_t sso_capacity = string().capacity();
+    return str.capacity() > sso_capacity ? str.capacity() + 1 : 0;
+}
+    
+} // namespace mem
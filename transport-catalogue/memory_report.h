@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mem {
+    
+// Оценка памяти, занимаемой компонентом, с разбивкой по частям.
+// bytes — собственные данные компонента без учёта parts
+struct ComponentUsage {
+    std::string name;
+    size_t bytes = 0;
+    std::vector<ComponentUsage> parts;
+    
+    size_t Total() const;
+};
+    
+void PrintUsage(const ComponentUsage& usage, std::ostream& out);
+    
+// Пиковый размер резидентной памяти процесса в байтах
+size_t GetPeakRss();
+    
+// Печатает пиковый RSS после каждой фазы работы программы.
+// Без потока вывода ничего не делает
+class PhaseTracker {
+public:
+    PhaseTracker() = default;
+    explicit PhaseTracker(std::ostream& out);
+    
+    void Mark(std::string_view phase) const;
+    bool IsEnabled() const;
+    std::ostream& Output() const;
+    
+private:
+    std::ostream* out_ = nullptr;
+};
+    
+// Память строки в куче сверх самого объекта std::string
+size_t StringBytes(const std::string& str);
+    
+template <typename T>
+size_t VectorBytes(const std::vector<T>& vec) {
+    return vec.capacity() * sizeof(T);
+}
+    
+template <typename T>
+size_t DequeBytes(const std::deque<T>& deq) {
+    // libstdc++ хранит элементы дека блоками по 512 байт
+    const size_t block = sizeof(T) < 512 ? 512 / sizeof(T) * sizeof(T) : sizeof(T);
+    const size_t per_block = block / sizeof(T);
+    const size_t blocks = (deq.size() + per_block - 1) / per_block + 1;
+    return blocks * block + blocks * sizeof(void*);
+}
+    
+// Служебные расходы хеш-таблицы: массив корзин и узлы с указателем
+// на следующий узел и сохранённым значением хеша
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t HashTableBytes(const std::unordered_map<Key, Value, Hash, Equal, Alloc>& table) {
+    using Node = typename std::unordered_map<Key, Value, Hash, Equal, Alloc>::value_type;
+    return table.bucket_count() * sizeof(void*)
+        + table.size() * (sizeof(void*) + sizeof(Node) + sizeof(size_t));
+}
+    
+template <typename Key, typename Compare, typename Alloc>
+size_t TreeBytes(const std::set<Key, Compare, Alloc>& tree) {
+    // Узел красно-чёрного дерева: цвет и три указателя
+    return tree.size() * (4 * sizeof(void*) + sizeof(Key));
+}
+    
+template <typename Key, typename Value, typename Compare, typename Alloc>
+size_t TreeBytes(const std::map<Key, Value, Compare, Alloc>& tree) {
+    return tree.size() * (4 * sizeof(void*) + sizeof(std::pair<const Key, Value>));
+}
+    
+} // namespace mem
@@ -0,0 +1,26 @@
+#include "number_format.h"
+
+using namespace std;
+
+namespace num {
+    
+namespace {
+// Самое длинное представление с 6 значащими цифрами: -1.23457e-308
+constexpr size_t MAX_DOUBLE_LENGTH = 32;
+    
+char* ToChars(char* buffer, double value) {
+    return to_chars(buffer, buffer + MAX_DOUBLE_LENGTH, value, chars_format::general, 6).ptr;
+}
+} // namespace
+    
+void Write(ostream& out, double value) {
+    char buffer[MAX_DOUBLE_LENGTH];
+    out.write(buffer, ToChars(buffer, value) - buffer);
+}
+    
+void Append(string& out, double value) {
+    char buffer[MAX_DOUBLE_LENGTH];
+    out.append(buffer, ToChars(buffer, value) - buffer);
+}
+    
+} // namespace num
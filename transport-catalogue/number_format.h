@@ -0,0 +1,41 @@
+#pragma once
+
+#include <charconv>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+namespace num {
+    
+// Печатает число так же, как operator<< потока с настройками по умолчанию
+// (%g, 6 значащих цифр), но без локали и флагов потока
+void Write(std::ostream& out, double value);
+    
+template <typename Integer, std::enable_if_t<std::is_integral_v<Integer> && !std::is_same_v<Integer, bool>, int> = 0>
+void Write(std::ostream& out, Integer value) {
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.write(buffer, result.ptr - buffer);
+}
+    
+// То же, что Write, но дописывает число в конец строки
+void Append(std::string& out, double value);
+    
+template <typename Integer, std::enable_if_t<std::is_integral_v<Integer> && !std::is_same_v<Integer, bool>, int> = 0>
+void Append(std::string& out, Integer value) {
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr - buffer);
+}
+    
+// Разбирает text целиком; false, если это не число или оно не помещается в Number
+template <typename Number>
+bool Parse(std::string_view text, Number& value) {
+    const char* end = text.data() + text.size();
+    const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end;
+}
+    
+} // namespace num
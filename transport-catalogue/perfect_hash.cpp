@@ -0,0 +1,169 @@
+#include "perfect_hash.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+using namespace std;
+
+namespace phash {
+    
+namespace {
+const uint64_t FINGERPRINT_SEED = 0xF1E2D3C4B5A69788ull;
+    
+uint32_t Fingerprint(string_view name) {
+    return static_cast<uint32_t>(Hash(name, FINGERPRINT_SEED) >> 32);
+}
+}
+    
+uint64_t Hash(string_view key, uint64_t seed) {
+    // FNV-1a с затравкой и перемешиванием splitmix64 на выходе
+    uint64_t hash = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+    for (const char c : key) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+    return hash;
+}
+    
+NameIndex::NameIndex(const vector<string_view>& names) {
+    vector<pair<string_view, uint32_t>> keys;
+    keys.reserve(names.size());
+    unordered_set<string_view> seen;
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (seen.insert(names[i]).second) {
+            keys.emplace_back(names[i], static_cast<uint32_t>(i));
+        }
+    }
+    
+    const size_t size = keys.size();
+    if (size == 0) {
+        return;
+    }
+    displacements_.assign(size, 0);
+    ids_.assign(size, NOT_FOUND);
+    fingerprints_.assign(size, 0);
+    
+    vector<vector<uint32_t>> buckets(size);
+    for (uint32_t i = 0; i < size; ++i) {
+        buckets[Hash(keys[i].first, 0) % size].push_back(i);
+    }
+    vector<uint32_t> bucket_order(size);
+    iota(bucket_order.begin(), bucket_order.end(), 0);
+    stable_sort(bucket_order.begin(), bucket_order.end(), [&buckets](uint32_t lhs, uint32_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+    
+    vector<bool> is_taken(size, false);
+    auto place = [this, &keys, &is_taken](uint32_t key, size_t slot) {
+        is_taken[slot] = true;
+        ids_[slot] = keys[key].second;
+        fingerprints_[slot] = Fingerprint(keys[key].first);
+    };
+    
+    // Корзины с несколькими именами: подбираем затравку, при которой
+    // все их имена попадают в свободные и разные слоты
+    size_t order_pos = 0;
+    vector<size_t> slots;
+    for (; order_pos < size && buckets[bucket_order[order_pos]].size() > 1; ++order_pos) {
+        const auto& bucket = buckets[bucket_order[order_pos]];
+        for (int32_t displacement = 1;; ++displacement) {
+            if (displacement == numeric_limits<int32_t>::max()) {
+                throw runtime_error("Failed to build perfect hash");
+            }
+            slots.clear();
+            bool is_placed = true;
+            for (uint32_t key : bucket) {
+                const size_t slot = Hash(keys[key].first, displacement) % size;
+                if (is_taken[slot] || find(slots.begin(), slots.end(), slot) != slots.end()) {
+                    is_placed = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (is_placed) {
+                for (size_t i = 0; i < bucket.size(); ++i) {
+                    place(bucket[i], slots[i]);
+                }
+                displacements_[bucket_order[order_pos]] = displacement;
+                break;
+            }
+        }
+    }
+    
+    // Корзины с одним именем занимают оставшиеся слоты напрямую
+    size_t free_slot = 0;
+    for (; order_pos < size && buckets[bucket_order[order_pos]].size() == 1; ++order_pos) {
+        while (is_taken[free_slot]) {
+            ++free_slot;
+        }
+        place(buckets[bucket_order[order_pos]].front(), free_slot);
+        displacements_[bucket_order[order_pos]] = -static_cast<int32_t>(free_slot) - 1;
+    }
+}
+    
+NameIndex::NameIndex(vector<int32_t> displacements, vector<uint32_t> ids, vector<uint32_t> fingerprints)
+    : displacements_(move(displacements)), ids_(move(ids)), fingerprints_(move(fingerprints)) {
+    if (displacements_.size() != ids_.size() || ids_.size() != fingerprints_.size()) {
+        throw invalid_argument("Inconsistent perfect hash tables");
+    }
+    // Отрицательное смещение -d-1 прямо задаёт слот d, и он должен быть внутри таблицы.
+    // Построение никогда не даёт INT32_MIN: у него нет пары среди положительных int32_t
+    const int64_t size = static_cast<int64_t>(ids_.size());
+    for (const int32_t displacement : displacements_) {
+        if (displacement == numeric_limits<int32_t>::min()
+            || (displacement < 0 && -static_cast<int64_t>(displacement) - 1 >= size)) {
+            throw invalid_argument("Perfect hash slot is out of bounds");
+        }
+    }
+}
+    
+uint32_t NameIndex::Find(string_view name) const {
+    if (ids_.empty()) {
+        return NOT_FOUND;
+    }
+    const size_t slot = GetSlot(name);
+    return fingerprints_[slot] == Fingerprint(name) ? ids_[slot] : NOT_FOUND;
+}
+    
+size_t NameIndex::Size() const {
+    return ids_.size();
+}
+    
+bool NameIndex::IsEmpty() const {
+    return ids_.empty();
+}
+    
+const vector<int32_t>& NameIndex::GetDisplacements() const {
+    return displacements_;
+}
+    
+const vector<uint32_t>& NameIndex::GetIds() const {
+    return ids_;
+}
+    
+const vector<uint32_t>& NameIndex::GetFingerprints() const {
+    return fingerprints_;
+}
+    
+mem::ComponentUsage NameIndex::GetMemoryUsage(string name) const {
+    return {move(name), mem::VectorBytes(displacements_) + mem::VectorBytes(ids_) + mem::VectorBytes(fingerprints_), {}};
+}
+    
+size_t NameIndex::GetSlot(string_view name) const {
+    const size_t size = ids_.size();
+    const int32_t displacement = displacements_[Hash(name, 0) % size];
+    if (displacement < 0) {
+        return static_cast<size_t>(-displacement - 1);
+    }
+    return Hash(name, displacement) % size;
+}
+    
+} // namespace phash
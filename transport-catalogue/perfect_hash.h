@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "memory_report.h"
+
+namespace phash {
+    
+uint64_t Hash(std::string_view key, uint64_t seed);
+    
+// Минимальная совершенная хеш-функция над набором имён (hash and displace).
+// Имя отображается в слот без коллизий, слот хранит номер элемента и отпечаток
+// имени, по которому отсеивается большинство отсутствующих в наборе имён.
+// Окончательную проверку сравнением строк выполняет владелец элементов
+class NameIndex {
+public:
+    static constexpr uint32_t NOT_FOUND = std::numeric_limits<uint32_t>::max();
+    
+    NameIndex() = default;
+    // Имени names[i] соответствует номер i. Повторные имена пропускаются
+    explicit NameIndex(const std::vector<std::string_view>& names);
+    NameIndex(std::vector<int32_t> displacements, std::vector<uint32_t> ids, std::vector<uint32_t> fingerprints);
+    
+    uint32_t Find(std::string_view name) const;
+    size_t Size() const;
+    bool IsEmpty() const;
+    
+    const std::vector<int32_t>& GetDisplacements() const;
+    const std::vector<uint32_t>& GetIds() const;
+    const std::vector<uint32_t>& GetFingerprints() const;
+    
+    mem::ComponentUsage GetMemoryUsage(std::string name) const;
+    
+private:
+    std::vector<int32_t> displacements_;
+    std::vector<uint32_t> ids_;
+    std::vector<uint32_t> fingerprints_;
+    
+    size_t GetSlot(std::string_view name) const;
+};
+    
+} // namespace phash
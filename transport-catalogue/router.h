@@ -20,7 +20,21 @@ private:
     using Graph = DirectedWeightedGraph<Weight>;
 
 public:
+    // Элемент таблицы маршрутов. Таблица хранится одним непрерывным массивом
+    // vertex_count * vertex_count, поэтому её можно сохранить в файл
+    // и использовать прямо из отображённой в память базы.
+    // Флаги занимают по 32 бита, чтобы в элементе не было байтов выравнивания
+    struct RouteEntry {
+        Weight weight;
+        EdgeId prev_edge;
+        uint32_t has_route;
+        uint32_t has_prev_edge;
+    };
+
     explicit Router(const Graph& graph);
+    // Использует готовую таблицу из vertex_count * vertex_count элементов,
+    // не копируя её. Таблица должна жить дольше маршрутизатора
+    Router(const Graph& graph, const RouteEntry* routes_table);
 
     struct RouteInfo {
         Weight weight;
@@ -28,47 +42,53 @@ public:
     };
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    
+    const RouteEntry* GetRoutesTable() const;
+    size_t GetRoutesTableSize() const;
+    // Память под таблицу, которой владеет сам маршрутизатор; у готовой таблицы она 0
+    size_t GetOwnedTableBytes() const;
 
 private:
-    struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
-    };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+    RouteEntry& At(VertexId from, VertexId to) {
+        return routes_internal_data_[from * vertex_count_ + to];
+    }
+    
+    const RouteEntry& At(VertexId from, VertexId to) const {
+        return routes_table_[from * vertex_count_ + to];
+    }
 
     void InitializeRoutesInternalData(const Graph& graph) {
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            At(vertex, vertex) = RouteEntry{ZERO_WEIGHT, 0, true, false};
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                 const auto& edge = graph.GetEdge(edge_id);
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                auto& route_internal_data = At(vertex, edge.to);
+                if (!route_internal_data.has_route || route_internal_data.weight > edge.weight) {
+                    route_internal_data = RouteEntry{edge.weight, edge_id, true, true};
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
+    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteEntry& route_from,
+                    const RouteEntry& route_to) {
+        auto& route_relaxing = At(vertex_from, vertex_to);
         const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
+        if (!route_relaxing.has_route || candidate_weight < route_relaxing.weight) {
+            const RouteEntry& prev = route_to.has_prev_edge ? route_to : route_from;
+            route_relaxing = {candidate_weight, prev.prev_edge, true, prev.has_prev_edge};
         }
     }
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
+    void RelaxRoutesInternalDataThroughVertex(VertexId vertex_through) {
+        for (VertexId vertex_from = 0; vertex_from < vertex_count_; ++vertex_from) {
+            if (const RouteEntry route_from = At(vertex_from, vertex_through); route_from.has_route) {
+                for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+                    if (const RouteEntry& route_to = At(vertex_through, vertex_to); route_to.has_route) {
+                        RelaxRoute(vertex_from, vertex_to, route_from, route_to);
                     }
                 }
             }
@@ -77,41 +97,73 @@ private:
 
     static constexpr Weight ZERO_WEIGHT{};
     const Graph& graph_;
-    RoutesInternalData routes_internal_data_;
+    size_t vertex_count_;
+    std::vector<RouteEntry> routes_internal_data_;
+    const RouteEntry* routes_table_;
 };
 
 template <typename Weight>
 Router<Weight>::Router(const Graph& graph)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    , vertex_count_(graph.GetVertexCount())
+    , routes_internal_data_(vertex_count_ * vertex_count_, RouteEntry{ZERO_WEIGHT, 0, false, false})
+    , routes_table_(routes_internal_data_.data())
 {
     InitializeRoutesInternalData(graph);
 
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+        RelaxRoutesInternalDataThroughVertex(vertex_through);
     }
 }
+    
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph, const RouteEntry* routes_table)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , routes_table_(routes_table)
+{
+}
 
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex is out of range");
+    }
+    const RouteEntry& route_internal_data = At(from, to);
+    if (!route_internal_data.has_route) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
+    const Weight weight = route_internal_data.weight;
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    for (const RouteEntry* entry = &route_internal_data;
+         entry->has_prev_edge;
+         entry = &At(from, graph_.GetEdge(entry->prev_edge).from))
     {
-        edges.push_back(*edge_id);
+        // В кратчайшем пути рёбер меньше, чем вершин; иначе таблица из файла зациклена
+        if (edges.size() >= vertex_count_) {
+            throw std::runtime_error("Routes table has a cycle");
+        }
+        edges.push_back(entry->prev_edge);
     }
     std::reverse(edges.begin(), edges.end());
 
     return RouteInfo{weight, std::move(edges)};
 }
+    
+template <typename Weight>
+const typename Router<Weight>::RouteEntry* Router<Weight>::GetRoutesTable() const {
+    return routes_table_;
+}
+    
+template <typename Weight>
+size_t Router<Weight>::GetRoutesTableSize() const {
+    return vertex_count_ * vertex_count_;
+}
+    
+template <typename Weight>
+size_t Router<Weight>::GetOwnedTableBytes() const {
+    return routes_internal_data_.capacity() * sizeof(RouteEntry);
+}
 
 }  // namespace graph
\ No newline at end of file
@@ -5,90 +5,120 @@
 #include "transport_catalogue.h"
 #include "transport_router.h"
 #include "graph.h"
+#include "base_delta.h"
+
+#include <google/protobuf/io/gzip_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 
 #include <string>
 #include <fstream>
 #include <algorithm>
 #include <vector>
 #include <memory>
+#include <future>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
 
 using namespace std;
 
 namespace serialization {
-
-Serializer::Serializer(tcat::TransportCatalogue& catalogue, std::shared_ptr<router::TransportRouter> tr, map_r::MapRenderer& map_renderer)
-        : tc_(catalogue), tr_ptr_(tr), mr_(map_renderer) {}
-    
-void Serializer::SerializeToFile(const string& file) {
-    ofstream ofs(file, ios::binary);
-    proto_tc_.Clear();
     
-    SerializeStops();
-    SerializeBuses();
-    SerializeDistances();
-    SerializeRenderSettings();
-    SerializeRouterSettings();
-    SerializeGraph();
-    SerializeTransportRouter();
+namespace {
+// Сигнатура базы с оглавлением; база старого формата начинается сразу с сообщения TransportCatalogue
+constexpr string_view SECTIONED_MAGIC{"TCPROTO\0", 8};
+    
+// Сообщение секции сериализуется прямо в поток сжатия, без несжатого промежуточного буфера
+string CompressSection(const google::protobuf::MessageLite& message) {
+    string data;
+    google::protobuf::io::StringOutputStream output(&data);
+    google::protobuf::io::GzipOutputStream gzip(&output);
+    if (!message.SerializeToZeroCopyStream(&gzip) || !gzip.Close()) {
+        throw runtime_error("Cannot compress base section");
+    }
+    return data;
+}
     
-    proto_tc_.SerializeToOstream(&ofs);
+string EncodeSection(const google::protobuf::MessageLite& message, Compression compression) {
+    return compression == Compression::GZIP ? CompressSection(message) : message.SerializeAsString();
 }
     
-shared_ptr<router::TransportRouter> Serializer::DeserializeFromFile(const string& file) {
-    ifstream ifs(file, ios::binary);
-    proto_tc_.Clear();
-    proto_tc_.ParseFromIstream(&ifs);
+bool DecodeSection(const string& data, Compression compression, google::protobuf::MessageLite& message) {
+    if (compression == Compression::NONE) {
+        return message.ParseFromString(data);
+    }
+    google::protobuf::io::ArrayInputStream input(data.data(), static_cast<int>(data.size()));
+    google::protobuf::io::GzipInputStream gzip(&input, google::protobuf::io::GzipInputStream::GZIP);
+    return message.ParseFromZeroCopyStream(&gzip);
+}
     
-    DeserializeCatalogue();
-    DeserializeGraph();
-    DeserializeRenderSettings();
-    return DeserializeTransportRouter();
+// Координаты пишутся в том виде, в каком хранятся в справочнике
+void SetCoordinates(proto_serialization::Stop& stop, geo::StoredCoordinates coords) {
+#ifdef TC_COMPACT_COORDINATES
+    stop.mutable_compact_coords()->set_lat(coords.lat);
+    stop.mutable_compact_coords()->set_lng(coords.lng);
+#else
+    stop.mutable_coords()->set_lat(coords.lat);
+    stop.mutable_coords()->set_lng(coords.lng);
+#endif
 }
     
-void Serializer::SerializeStops() {
-    for (const auto& [name, stop_ptr] : tc_.GetAllStops()) {
-        proto_serialization::Stop stop;
-        stop.set_name(stop_ptr->name);
-        proto_serialization::Coordinates coords;
-        coords.set_lat(stop_ptr->coordinates.lat);
-        coords.set_lng(stop_ptr->coordinates.lng);
-        *stop.mutable_coords() = coords;
-        
-        *proto_tc_.add_stops() = stop; 
+geo::StoredCoordinates GetCoordinates(const proto_serialization::Stop& stop) {
+    if (stop.has_compact_coords()) {
+        return geo::ToStored(geo::CompactCoordinates{stop.compact_coords().lat(), stop.compact_coords().lng()});
     }
+    return geo::ToStored(geo::Coordinates{stop.coords().lat(), stop.coords().lng()});
 }
     
-void Serializer::SerializeBuses() {
-    for (const auto& [name, bus_ptr] : tc_.GetAllBuses()) {
-        proto_serialization::Bus bus;
-        bus.set_name(bus_ptr->name);
-        bus.set_is_circular(bus_ptr->is_circular);
-        int num_of_ops = (bus_ptr->is_circular ? bus_ptr->stops.size() : bus_ptr->stops.size() / 2 + 1);
-        for (int i = 0; i < num_of_ops; ++i) {
-            proto_serialization::Stop stop;
-            stop.set_name(bus_ptr->stops[i]->name);
-            proto_serialization::Coordinates coords;
-            coords.set_lat(bus_ptr->stops[i]->coordinates.lat);
-            coords.set_lng(bus_ptr->stops[i]->coordinates.lng);
-            *stop.mutable_coords() = coords;
-            *bus.add_stops() = stop;
-        }
-        *proto_tc_.add_buses() = bus;
+proto_serialization::Color SerializeColor(const svg::Color& color) {
+    proto_serialization::Color result;
+    if (holds_alternative<string>(color)) {
+        result.set_color(get<string>(color));
+    } else if (holds_alternative<svg::Rgb>(color)) {
+        svg::Rgb rgb = get<svg::Rgb>(color);
+        proto_serialization::Rgb proto_rgb;
+        
+        proto_rgb.set_red(rgb.red);
+        proto_rgb.set_green(rgb.green);
+        proto_rgb.set_blue(rgb.blue);
+
+        *result.mutable_rgb() = proto_rgb;
+    } else if (holds_alternative<svg::Rgba>(color)) {
+        svg::Rgba rgba = get<svg::Rgba>(color);
+        proto_serialization::Rgba proto_rgba;
+        
+        proto_rgba.set_red(rgba.red);
+        proto_rgba.set_green(rgba.green);
+        proto_rgba.set_blue(rgba.blue);
+        proto_rgba.set_opacity(rgba.opacity);
+
+        *result.mutable_rgba() = proto_rgba;
     }
+    return result;
 }
     
-void Serializer::SerializeDistances() {
-    for (const auto& [stops_pair, dist] : tc_.GetAllDistances()) {
-        proto_serialization::Distance distance;
-        distance.set_from(stops_pair.first->name);
-        distance.set_to(stops_pair.second->name);
-        distance.set_distance(dist);
-        *proto_tc_.add_distances() = distance;
+svg::Color DeserializeColor(const proto_serialization::Color& proto_color) {
+    if (proto_color.has_rgb()) {
+        return svg::Rgb{
+            proto_color.rgb().red(),
+            proto_color.rgb().green(),
+            proto_color.rgb().blue()
+        };
+    } else if (proto_color.has_rgba()) {
+        return svg::Rgba{
+            proto_color.rgba().red(),
+            proto_color.rgba().green(),
+            proto_color.rgba().blue(),
+            proto_color.rgba().opacity()
+        };
+    } else {
+        return {proto_color.color()};
     }
 }
-    
-void Serializer::SerializeRenderSettings() {
-    const map_r::RenderSettings& settings = mr_.GetSettings();
+}
+
+proto_serialization::RenderSettings SerializeRenderSettings(const map_r::RenderSettings& settings) {
     proto_serialization::RenderSettings proto_settings;
     
     proto_settings.set_width(settings.width);
@@ -115,195 +145,465 @@ void Serializer::SerializeRenderSettings() {
     for (const svg::Color& color : settings.color_palette) {
         *proto_settings.add_color_palette() = SerializeColor(color);
     }
+    return proto_settings;
+}
     
-    *proto_tc_.mutable_render_settings() = proto_settings;
+proto_serialization::RouterSettings SerializeRouterSettings(const router::RouterSettings& settings) {
+    proto_serialization::RouterSettings proto_settings;
+    proto_settings.set_bus_wait_time(settings.bus_wait_time);
+    proto_settings.set_bus_velocity(settings.bus_velocity);
+    return proto_settings;
 }
     
-proto_serialization::Color Serializer::SerializeColor(const svg::Color& color) const {
-    proto_serialization::Color result;
-    if (holds_alternative<string>(color)) {
-        result.set_color(get<string>(color));
-    } else if (holds_alternative<svg::Rgb>(color)) {
-        svg::Rgb rgb = get<svg::Rgb>(color);
-        proto_serialization::Rgb proto_rgb;
-        
-        proto_rgb.set_red(rgb.red);
-        proto_rgb.set_green(rgb.green);
-        proto_rgb.set_blue(rgb.blue);
-
-        *result.mutable_rgb() = proto_rgb;
-    } else if (holds_alternative<svg::Rgba>(color)) {
-        svg::Rgba rgba = get<svg::Rgba>(color);
-        proto_serialization::Rgba proto_rgba;
-        
-        proto_rgba.set_red(rgba.red);
-        proto_rgba.set_green(rgba.green);
-        proto_rgba.set_blue(rgba.blue);
-        proto_rgba.set_opacity(rgba.opacity);
-
-        *result.mutable_rgba() = proto_rgba;
+map_r::RenderSettings DeserializeRenderSettings(const proto_serialization::RenderSettings& proto_settings) {
+    map_r::RenderSettings settings;
+    
+    settings.width = proto_settings.width();
+    settings.height = proto_settings.height();
+    settings.padding = proto_settings.padding();
+    settings.line_width = proto_settings.line_width();
+    settings.stop_radius = proto_settings.stop_radius();
+    settings.bus_label_font_size = proto_settings.bus_label_font_size();
+    settings.bus_label_offset = svg::Point{proto_settings.bus_label_offset().x(), proto_settings.bus_label_offset().y()};
+    settings.stop_label_font_size = proto_settings.stop_label_font_size();
+    settings.stop_label_offset = svg::Point{proto_settings.stop_label_offset().x(), proto_settings.stop_label_offset().y()};
+    settings.underlayer_color = DeserializeColor(proto_settings.underlayer_color());
+    settings.underlayer_width = proto_settings.underlayer_width();
+    for (const auto& proto_color : proto_settings.color_palette()) {
+        settings.color_palette.push_back(DeserializeColor(proto_color));
     }
-    return result;
+    return settings;
 }
     
-void Serializer::SerializeRouterSettings() {
-    proto_serialization::RouterSettings proto_settings;
-    router::RouterSettings settings = tr_ptr_->GetSettings();
+router::RouterSettings DeserializeRouterSettings(const proto_serialization::RouterSettings& proto_settings) {
+    router::RouterSettings settings;
+    settings.bus_wait_time = proto_settings.bus_wait_time();
+    settings.bus_velocity = proto_settings.bus_velocity();
+    return settings;
+}
     
-    proto_settings.set_bus_wait_time(settings.bus_wait_time);
-    proto_settings.set_bus_velocity(settings.bus_velocity);
-    *proto_tc_.mutable_router_settings() = proto_settings;
+Serializer::Serializer(tcat::TransportCatalogue& catalogue, std::shared_ptr<router::TransportRouter> tr, map_r::MapRenderer& map_renderer)
+        : tc_(catalogue), tr_ptr_(tr), mr_(map_renderer),
+          proto_tc_(google::protobuf::Arena::CreateMessage<proto_serialization::TransportCatalogue>(&arena_)) {}
+    
+void Serializer::EncodeCatalogueSections(Compression compression) {
+    proto_tc_->Clear();
+    proto_tc_->set_version(INDEXED_VERSION);
+    SerializeStops();
+    SerializeBuses();
+    SerializeDistances();
+    SerializeNameIndex(tc_.GetStopIndex(), *proto_tc_->mutable_stop_index());
+    SerializeNameIndex(tc_.GetBusIndex(), *proto_tc_->mutable_bus_index());
+    
+    encoded_sections_[proto_serialization::BaseSection::CATALOGUE] = EncodeSection(*proto_tc_, compression);
+    encoded_sections_[proto_serialization::BaseSection::RENDER_SETTINGS]
+        = EncodeSection(serialization::SerializeRenderSettings(mr_.GetSettings()), compression);
+    encoded_sections_[proto_serialization::BaseSection::ROUTER_SETTINGS]
+        = EncodeSection(serialization::SerializeRouterSettings(tr_ptr_->GetSettings()), compression);
 }
     
-void Serializer::SerializeGraph() {
-    proto_serialization::Graph proto_graph;
-    vector<graph::Edge<double>> edges = tr_ptr_->GetGraph().GetAllEdges();
-    vector<vector<size_t>> incidence_lists = tr_ptr_->GetGraph().GetAllIncidenceLists();
-    for (const auto& edge : edges) {
-        proto_serialization::Edge proto_edge;
-        proto_edge.set_from(edge.from);
-        proto_edge.set_to(edge.to);
-	proto_edge.set_name(edge.name);
-        proto_edge.set_type(edge.type == graph::EdgeType::WAIT ? proto_serialization::Edge::WAIT : proto_serialization::Edge::TRAVEL);
-        proto_edge.set_span_count(edge.span_count);
-        proto_edge.set_weight(edge.weight);
-        *proto_graph.add_edges() = proto_edge;
+void Serializer::EncodeGraphSection(Compression compression) {
+    tr_ptr_->BuildGraph();
+    // Сообщение графа не связано с proto_tc_, так что справочник можно кодировать в это же время
+    auto* transport_router = google::protobuf::Arena::CreateMessage<proto_serialization::TransportRouter>(&arena_);
+    SerializeGraph(*transport_router->mutable_graph());
+    encoded_sections_[proto_serialization::BaseSection::GRAPH] = EncodeSection(*transport_router, compression);
+}
+    
+void Serializer::EncodeRenderedMapSection(Compression compression) {
+    const auto& rendered_map = mr_.GetRenderedMap();
+    if (!rendered_map) {
+        return;
     }
-    for (const auto& incidence_list : incidence_lists) {
-        proto_serialization::IncidenceList list;
-        for (const auto& id : incidence_list) {
-            list.add_edge_ids(id);
+    auto* proto_map = google::protobuf::Arena::CreateMessage<proto_serialization::RenderedMap>(&arena_);
+    proto_map->set_json(*rendered_map);
+    encoded_sections_[proto_serialization::BaseSection::RENDERED_MAP] = EncodeSection(*proto_map, compression);
+}
+    
+void Serializer::SerializeDeltaToFile(const string& file, const string& parent, const vector<string>& parent_deltas) {
+    Serializer parent_serializer(tc_, nullptr, mr_);
+    parent_serializer.ReadBase(parent, BaseParts{}, parent_deltas);
+    
+    proto_tc_->Clear();
+    proto_tc_->set_version(INDEXED_VERSION);
+    SerializeStops();
+    SerializeBuses();
+    SerializeDistances();
+    SerializeRenderSettings();
+    SerializeRouterSettings();
+    
+    proto_serialization::BaseDelta delta = MakeDelta(*parent_serializer.proto_tc_, *proto_tc_);
+    delta.set_parent_hash(HashBaseFile(parent_deltas.empty() ? parent : parent_deltas.back()));
+    WriteDelta(file, delta);
+}
+    
+shared_ptr<router::TransportRouter> Serializer::DeserializeFromFile(const string& file, BaseParts parts,
+                                                                    const vector<string>& deltas) {
+    ReadBase(file, parts, deltas);
+    
+    // Граф и настройки отрисовки не зависят от справочника и собираются параллельно с ним
+    future<graph::DirectedWeightedGraph<double>> graph;
+    if (parts.router && parts.graph) {
+        graph = async(launch::async, [this] { return DeserializeGraph(); });
+    }
+    future<void> render_settings;
+    if (parts.render_settings) {
+        render_settings = async(launch::async, [this] { DeserializeRenderSettings(); });
+    }
+    
+    DeserializeCatalogue();
+    if (render_settings.valid()) {
+        render_settings.get();
+    }
+    if (!parts.router) {
+        return nullptr;
+    }
+    return DeserializeTransportRouter(graph.valid() ? graph.get() : graph::DirectedWeightedGraph<double>{});
+}
+    
+void Serializer::ReadBase(const string& file, BaseParts parts, const vector<string>& deltas) {
+    ifstream ifs(file, ios::binary);
+    if (!ifs) {
+        throw runtime_error("Cannot open base " + file);
+    }
+    proto_tc_->Clear();
+    if (!ReadSections(ifs, parts)) {
+        ifs.clear();
+        ifs.seekg(0);
+        if (!proto_tc_->ParseFromIstream(&ifs)) {
+            throw runtime_error("Malformed base " + file);
         }
-        *proto_graph.add_incidence_lists() = list;
     }
-    *proto_tc_.mutable_transport_router()->mutable_graph() = proto_graph;
+    
+    // Каждая дельта должна быть выпущена ровно к предыдущему файлу цепочки
+    string_view parent = file;
+    for (const string& delta_file : deltas) {
+        const proto_serialization::BaseDelta delta = ReadDelta(delta_file);
+        if (delta.parent_hash() != HashBaseFile(string(parent))) {
+            throw runtime_error("Base delta " + delta_file + " does not match its parent " + string(parent));
+        }
+        ApplyDelta(delta, *proto_tc_);
+        parent = delta_file;
+    }
+    // Карта родителя к базе с дельтами уже не подходит
+    if (!deltas.empty()) {
+        proto_tc_->clear_rendered_map();
+    }
 }
     
-void Serializer::SerializeTransportRouter() {
-    for (const auto& [name, id] : tr_ptr_->GetWaitVertexes()) {
-        (*proto_tc_.mutable_transport_router()->mutable_wait_vertexes())[name] = id;
+void Serializer::WriteEncodedSections(const string& file, Compression compression) {
+    proto_serialization::BaseContents contents;
+    contents.set_codec(compression == Compression::GZIP ? proto_serialization::BaseContents::GZIP
+                                                        : proto_serialization::BaseContents::NONE);
+    uint64_t offset = 0;
+    for (size_t id = 0; id < encoded_sections_.size(); ++id) {
+        if (!encoded_sections_[id]) {
+            continue;
+        }
+        proto_serialization::BaseSection* section = contents.add_sections();
+        section->set_id(static_cast<proto_serialization::BaseSection::Id>(id));
+        section->set_offset(offset);
+        section->set_size(encoded_sections_[id]->size());
+        offset += encoded_sections_[id]->size();
     }
-    for (const auto& [name, id] : tr_ptr_->GetTravelVertexes()) {
-        (*proto_tc_.mutable_transport_router()->mutable_travel_vertexes())[name] = id;
+    const string contents_data = contents.SerializeAsString();
+    const uint32_t contents_size = static_cast<uint32_t>(contents_data.size());
+    
+    ofstream output(file, ios::binary);
+    output.write(SECTIONED_MAGIC.data(), SECTIONED_MAGIC.size());
+    output.write(reinterpret_cast<const char*>(&contents_size), sizeof(contents_size));
+    output.write(contents_data.data(), contents_data.size());
+    for (const auto& data : encoded_sections_) {
+        if (data) {
+            output.write(data->data(), data->size());
+        }
     }
 }
     
-void Serializer::DeserializeCatalogue() {
-    for (const auto& stop : proto_tc_.stops()) {
-        tc_.AddStop({stop.name(), {stop.coords().lat(), stop.coords().lng()}});
+bool Serializer::ReadSections(istream& input, BaseParts parts) {
+    string magic(SECTIONED_MAGIC.size(), '\0');
+    uint32_t contents_size = 0;
+    if (!input.read(magic.data(), magic.size()) || magic != SECTIONED_MAGIC
+        || !input.read(reinterpret_cast<char*>(&contents_size), sizeof(contents_size))) {
+        return false;
+    }
+    string contents_data(contents_size, '\0');
+    proto_serialization::BaseContents contents;
+    if (!input.read(contents_data.data(), contents_size) || !contents.ParseFromString(contents_data)) {
+        throw runtime_error("Malformed base contents");
+    }
+    if (contents.codec() != proto_serialization::BaseContents::NONE
+        && contents.codec() != proto_serialization::BaseContents::GZIP) {
+        throw runtime_error("Unsupported base codec");
+    }
+    const Compression compression = contents.codec() == proto_serialization::BaseContents::GZIP
+        ? Compression::GZIP : Compression::NONE;
+    const streamoff data_start = input.tellg();
+    
+    auto* render_settings = google::protobuf::Arena::CreateMessage<proto_serialization::RenderSettings>(&arena_);
+    auto* router_settings = google::protobuf::Arena::CreateMessage<proto_serialization::RouterSettings>(&arena_);
+    auto* transport_router = google::protobuf::Arena::CreateMessage<proto_serialization::TransportRouter>(&arena_);
+    auto* rendered_map = google::protobuf::Arena::CreateMessage<proto_serialization::RenderedMap>(&arena_);
+    bool has_rendered_map = false;
+    vector<pair<google::protobuf::Message*, string>> sections;
+    for (const auto& section : contents.sections()) {
+        google::protobuf::Message* target = nullptr;
+        switch (section.id()) {
+            case proto_serialization::BaseSection::CATALOGUE:
+                target = proto_tc_;
+                break;
+            case proto_serialization::BaseSection::RENDER_SETTINGS:
+                target = parts.render_settings ? render_settings : nullptr;
+                break;
+            case proto_serialization::BaseSection::ROUTER_SETTINGS:
+                target = parts.router ? router_settings : nullptr;
+                break;
+            case proto_serialization::BaseSection::GRAPH:
+                target = parts.router && parts.graph ? transport_router : nullptr;
+                break;
+            case proto_serialization::BaseSection::RENDERED_MAP:
+                target = parts.render_settings ? rendered_map : nullptr;
+                has_rendered_map = target != nullptr;
+                break;
+            default:
+                break;
+        }
+        if (!target) {
+            continue;
+        }
+        string data(section.size(), '\0');
+        input.seekg(data_start + static_cast<streamoff>(section.offset()));
+        if (!input.read(data.data(), data.size())) {
+            throw runtime_error("Malformed base section");
+        }
+        sections.emplace_back(target, move(data));
     }
     
-    for (const auto& distance : proto_tc_.distances()) {
-        tcat::Stop* from = tc_.FindStop(distance.from());
-        tcat::Stop* to = tc_.FindStop(distance.to());
-        tc_.AddDistance(from, to, distance.distance());
+    // Секции читаются с диска по очереди, а разбираются параллельно, каждая в своё сообщение;
+    // арена потокобезопасна, так что все они размещаются в ней
+    vector<future<bool>> parsed;
+    parsed.reserve(sections.size());
+    for (const auto& [target, data] : sections) {
+        parsed.push_back(async(launch::async, [message = target, &bytes = data, compression] {
+            return DecodeSection(bytes, compression, *message);
+        }));
+    }
+    bool is_valid = true;
+    for (auto& result : parsed) {
+        is_valid = result.get() && is_valid;
+    }
+    if (!is_valid) {
+        throw runtime_error("Malformed base section");
+    }
+    
+    proto_tc_->unsafe_arena_set_allocated_render_settings(render_settings);
+    proto_tc_->unsafe_arena_set_allocated_router_settings(router_settings);
+    proto_tc_->unsafe_arena_set_allocated_transport_router(transport_router);
+    if (has_rendered_map) {
+        proto_tc_->unsafe_arena_set_allocated_rendered_map(rendered_map);
+    }
+    return true;
+}
+    
+void Serializer::SerializeStops() {
+    const auto& stops = tc_.GetAllStops();
+    proto_tc_->mutable_stops()->Reserve(static_cast<int>(stops.size()));
+    for (const tcat::Stop& catalogue_stop : stops) {
+        proto_serialization::Stop* stop = proto_tc_->add_stops();
+        stop->set_name(catalogue_stop.name);
+        SetCoordinates(*stop, catalogue_stop.coordinates);
     }
+}
     
-    for (const auto& bus : proto_tc_.buses()) {
-        vector<string> stop_names;
-        for (const auto& stop : bus.stops()) {
-            stop_names.push_back(stop.name());
+void Serializer::SerializeBuses() {
+    const auto& buses = tc_.GetAllBuses();
+    proto_tc_->mutable_buses()->Reserve(static_cast<int>(buses.size()));
+    for (const tcat::Bus& catalogue_bus : buses) {
+        proto_serialization::Bus* bus = proto_tc_->add_buses();
+        bus->set_name(catalogue_bus.name);
+        bus->set_is_circular(catalogue_bus.is_circular);
+        bus->mutable_stop_ids()->Reserve(static_cast<int>(catalogue_bus.stops.size()));
+        for (const tcat::Stop* stop_ptr : catalogue_bus.stops) {
+            bus->add_stop_ids(static_cast<uint32_t>(stop_ptr->id));
         }
-        
-        tc_.AddBus(
-            {
-                bus.name(),
-                stop_names,
-                bus.is_circular()
-            });
     }
 }
     
-void Serializer::DeserializeRenderSettings() {
-    map_r::RenderSettings settings;
-    proto_serialization::RenderSettings proto_settings = proto_tc_.render_settings();
+void Serializer::SerializeDistances() {
+    const auto& distances = tc_.GetAllDistances();
+    proto_tc_->mutable_distances()->Reserve(static_cast<int>(distances.size()));
+    for (const auto& [stops_pair, dist] : distances) {
+        proto_serialization::Distance* distance = proto_tc_->add_distances();
+        distance->set_from_id(static_cast<uint32_t>(stops_pair.first->id));
+        distance->set_to_id(static_cast<uint32_t>(stops_pair.second->id));
+        distance->set_distance(dist);
+    }
+}
     
-    settings.width = proto_settings.width();
-    settings.height = proto_settings.height();
-    settings.padding = proto_settings.padding();
-    settings.line_width = proto_settings.line_width();
-    settings.stop_radius = proto_settings.stop_radius();
-    settings.bus_label_font_size = proto_settings.bus_label_font_size();
-    settings.bus_label_offset = svg::Point{proto_settings.bus_label_offset().x(), proto_settings.bus_label_offset().y()};
-    settings.stop_label_font_size = proto_settings.stop_label_font_size();
-    settings.stop_label_offset = svg::Point{proto_settings.stop_label_offset().x(), proto_settings.stop_label_offset().y()};
-    settings.underlayer_color = DeserializeColor(proto_settings.underlayer_color());
-    settings.underlayer_width = proto_settings.underlayer_width();
-    for (const auto& proto_color : proto_settings.color_palette()) {
-        settings.color_palette.push_back(DeserializeColor(proto_color));
+void Serializer::SerializeRenderSettings() {
+    *proto_tc_->mutable_render_settings() = serialization::SerializeRenderSettings(mr_.GetSettings());
+}
+    
+void Serializer::SerializeRouterSettings() {
+    *proto_tc_->mutable_router_settings() = serialization::SerializeRouterSettings(tr_ptr_->GetSettings());
+}
+    
+void Serializer::SerializeGraph(proto_serialization::Graph& proto_graph) const {
+    const auto& edges = tr_ptr_->GetGraph().GetAllEdges();
+    const auto& incidence_lists = tr_ptr_->GetGraph().GetAllIncidenceLists();
+    proto_graph.mutable_edges()->Reserve(static_cast<int>(edges.size()));
+    for (const auto& edge : edges) {
+        proto_serialization::Edge* proto_edge = proto_graph.add_edges();
+        proto_edge->set_from(edge.from);
+        proto_edge->set_to(edge.to);
+        // Вместо имени — номер остановки (вершина ожидания 2 * id) или автобуса
+        if (edge.type == graph::EdgeType::WAIT) {
+            proto_edge->set_type(proto_serialization::Edge::WAIT);
+            proto_edge->set_owner_id(static_cast<uint32_t>(edge.from / 2));
+        } else {
+            proto_edge->set_type(proto_serialization::Edge::TRAVEL);
+            proto_edge->set_owner_id(static_cast<uint32_t>(tc_.FindBus(edge.name)->id));
+        }
+        proto_edge->set_span_count(edge.span_count);
+        proto_edge->set_weight(edge.weight);
+    }
+    proto_graph.mutable_incidence_lists()->Reserve(static_cast<int>(incidence_lists.size()));
+    for (const auto& incidence_list : incidence_lists) {
+        proto_serialization::IncidenceList* list = proto_graph.add_incidence_lists();
+        list->mutable_edge_ids()->Reserve(static_cast<int>(incidence_list.size()));
+        for (const auto& id : incidence_list) {
+            list->add_edge_ids(id);
+        }
     }
-    mr_.LoadSettings(settings);
 }
     
-svg::Color Serializer::DeserializeColor(const proto_serialization::Color& proto_color) const {
-    if (proto_color.has_rgb()) {
-        return svg::Rgb{
-            proto_color.rgb().red(),
-            proto_color.rgb().green(),
-            proto_color.rgb().blue()
-        };
-    } else if (proto_color.has_rgba()) {
-        return svg::Rgba{
-            proto_color.rgba().red(),
-            proto_color.rgba().green(),
-            proto_color.rgba().blue(),
-            proto_color.rgba().opacity()
-        };
-    } else {
-        return {proto_color.color()};
+void Serializer::SerializeNameIndex(const phash::NameIndex& index, proto_serialization::NameIndex& proto_index) const {
+    *proto_index.mutable_displacements() = {index.GetDisplacements().begin(), index.GetDisplacements().end()};
+    *proto_index.mutable_ids() = {index.GetIds().begin(), index.GetIds().end()};
+    *proto_index.mutable_fingerprints() = {index.GetFingerprints().begin(), index.GetFingerprints().end()};
+}
+    
+void Serializer::DeserializeCatalogue() {
+    // Индексы имён из базы годятся, только если остановки и автобусы
+    // загружаются в том же порядке, в котором по ним строился индекс
+    const bool has_name_index = proto_tc_->stop_index().ids_size() == proto_tc_->stops_size()
+        && proto_tc_->bus_index().ids_size() == proto_tc_->buses_size();
+    if (has_name_index) {
+        tc_.SetNameIndex(DeserializeNameIndex(proto_tc_->stop_index()), DeserializeNameIndex(proto_tc_->bus_index()));
+    }
+    
+    for (const auto& stop : proto_tc_->stops()) {
+        tc_.AddStop({stop.name(), GetCoordinates(stop)});
+    }
+    
+    DeserializeDistances();
+    DeserializeBuses();
+    
+    if (!has_name_index) {
+        tc_.BuildNameIndex();
     }
 }
     
-router::RouterSettings Serializer::DeserializeRouterSettings() {
-    router::RouterSettings settings;
-    proto_serialization::RouterSettings proto_settings = proto_tc_.router_settings();
+void Serializer::DeserializeDistances() {
+    const bool indexed = proto_tc_->version() >= INDEXED_VERSION;
+    for (const auto& distance : proto_tc_->distances()) {
+        tcat::Stop* from = indexed ? tc_.GetStop(distance.from_id()) : tc_.FindStop(distance.from());
+        tcat::Stop* to = indexed ? tc_.GetStop(distance.to_id()) : tc_.FindStop(distance.to());
+        tc_.AddDistance(from, to, distance.distance());
+    }
+}
     
-    settings.bus_wait_time = proto_settings.bus_wait_time();
-    settings.bus_velocity = proto_settings.bus_velocity();
-    return settings;
+void Serializer::DeserializeBuses() {
+    const bool indexed = proto_tc_->version() >= INDEXED_VERSION;
+    for (const auto& bus : proto_tc_->buses()) {
+        vector<tcat::Stop*> stops;
+        if (indexed) {
+            stops.reserve(bus.stop_ids_size());
+            for (uint32_t id : bus.stop_ids()) {
+                stops.push_back(tc_.GetStop(id));
+            }
+        } else {
+            stops.reserve(bus.stops_size());
+            for (const auto& stop : bus.stops()) {
+                stops.push_back(tc_.FindStop(stop.name()));
+            }
+        }
+        tc_.AddBus(bus.name(), move(stops), bus.is_circular());
+    }
+}
+    
+phash::NameIndex Serializer::DeserializeNameIndex(const proto_serialization::NameIndex& proto_index) const {
+    return phash::NameIndex(
+        {proto_index.displacements().begin(), proto_index.displacements().end()},
+        {proto_index.ids().begin(), proto_index.ids().end()},
+        {proto_index.fingerprints().begin(), proto_index.fingerprints().end()});
 }
     
-graph::DirectedWeightedGraph<double> Serializer::DeserializeGraph() {
-    vector<graph::Edge<double>> edges(proto_tc_.transport_router().graph().edges_size());
-    vector<vector<graph::EdgeId>> incidence_lists(proto_tc_.transport_router().graph().incidence_lists_size());
+void Serializer::DeserializeRenderSettings() {
+    mr_.LoadSettings(serialization::DeserializeRenderSettings(proto_tc_->render_settings()));
+    if (proto_tc_->has_rendered_map()) {
+        mr_.SetRenderedMap(move(*proto_tc_->mutable_rendered_map()->mutable_json()));
+    }
+}
     
-    for (const auto& proto_edge : proto_tc_.transport_router().graph().edges()) {
-        graph::Edge<double> edge {
+router::RouterSettings Serializer::DeserializeRouterSettings() {
+    return serialization::DeserializeRouterSettings(proto_tc_->router_settings());
+}
+    
+graph::DirectedWeightedGraph<double> Serializer::DeserializeGraph() const {
+    const proto_serialization::Graph& proto_graph = proto_tc_->transport_router().graph();
+    const bool indexed = proto_tc_->version() >= INDEXED_VERSION;
+    vector<graph::Edge<double>> edges;
+    vector<vector<graph::EdgeId>> incidence_lists;
+    edges.reserve(proto_graph.edges_size());
+    incidence_lists.reserve(proto_graph.incidence_lists_size());
+    
+    for (const auto& proto_edge : proto_graph.edges()) {
+        const bool is_wait = proto_edge.type() == proto_serialization::Edge::WAIT;
+        if (proto_edge.from() >= static_cast<uint32_t>(proto_graph.incidence_lists_size())
+            || proto_edge.to() >= static_cast<uint32_t>(proto_graph.incidence_lists_size())) {
+            throw runtime_error("Edge vertex is out of range");
+        }
+        string name;
+        if (!indexed) {
+            name = proto_edge.name();
+        } else {
+            const int owners_count = is_wait ? proto_tc_->stops_size() : proto_tc_->buses_size();
+            if (proto_edge.owner_id() >= static_cast<uint32_t>(owners_count)) {
+                throw runtime_error("Edge owner is out of range");
+            }
+            const int owner = static_cast<int>(proto_edge.owner_id());
+            name = is_wait ? proto_tc_->stops(owner).name() : proto_tc_->buses(owner).name();
+        }
+        edges.push_back({
             static_cast<graph::VertexId>(proto_edge.from()),
             static_cast<graph::VertexId>(proto_edge.to()),
-	    proto_edge.name(),
-            (proto_edge.type() == proto_serialization::Edge::WAIT ? graph::EdgeType::WAIT : graph::EdgeType::TRAVEL),
+            move(name),
+            (is_wait ? graph::EdgeType::WAIT : graph::EdgeType::TRAVEL),
             proto_edge.span_count(),
             proto_edge.weight()
-        };
-        edges.push_back(edge);
+        });
     }
     
-    for (const auto& proto_incidence_list : proto_tc_.transport_router().graph().incidence_lists()) {
-        vector<graph::EdgeId> tmp_incidence_list;
-        for (const auto& id : proto_incidence_list.edge_ids()) {
-            tmp_incidence_list.push_back(static_cast<size_t>(id));
+    for (const auto& proto_incidence_list : proto_graph.incidence_lists()) {
+        for (uint32_t id : proto_incidence_list.edge_ids()) {
+            if (id >= edges.size()) {
+                throw runtime_error("Edge id is out of range");
+            }
         }
-        incidence_lists.push_back(tmp_incidence_list);
+        incidence_lists.emplace_back(proto_incidence_list.edge_ids().begin(), proto_incidence_list.edge_ids().end());
     }
-    return graph::DirectedWeightedGraph<double>(edges, incidence_lists);
+    return graph::DirectedWeightedGraph<double>(move(edges), move(incidence_lists));
 }
     
-shared_ptr<router::TransportRouter> Serializer::DeserializeTransportRouter() {
-    graph::DirectedWeightedGraph<double> graph = DeserializeGraph();
-    //unordered_map<string, size_t> wait_vertexes(proto_tc_.transport_router().wait_vertexes().begin(), proto_tc_.transport_router().wait_vertexes().end());
-    //unordered_map<string, size_t> travel_vertexes(proto_tc_.transport_router().travel_vertexes().begin(), proto_tc_.transport_router().travel_vertexes().end());
-    unordered_map<string, size_t> wait_vertexes;
-    for (const auto& [name, id] : proto_tc_.transport_router().wait_vertexes()) {
-    	wait_vertexes[name] = id;
-    }
-    unordered_map<string, size_t> travel_vertexes;
-    for (const auto& [name, id] : proto_tc_.transport_router().wait_vertexes()) {
-    	travel_vertexes[name] = id;
+shared_ptr<router::TransportRouter> Serializer::DeserializeTransportRouter(graph::DirectedWeightedGraph<double> graph) {
+    // В старых базах граф пустой, тогда он строится при первом запросе маршрута
+    shared_ptr<router::TransportRouter> tr;
+    if (graph.GetEdgeCount() > 0 && graph.GetVertexCount() == tc_.GetAllStopsCount() * 2) {
+        tr = make_shared<router::TransportRouter>(tc_, move(graph));
+    } else {
+        tr = make_shared<router::TransportRouter>(tc_);
     }
-
-    //shared_ptr<router::TransportRouter> tr = make_shared<router::TransportRouter>(tc_, graph, wait_vertexes, travel_vertexes);
-    shared_ptr<router::TransportRouter> tr = make_shared<router::TransportRouter>(tc_);
     tr->LoadSettings(DeserializeRouterSettings());
     return tr;
 }
@@ -6,19 +6,73 @@
 #include "transport_catalogue.pb.h"
 #include "transport_router.pb.h"
 #include "svg.h"
+#include "perfect_hash.h"
 
+#include <google/protobuf/arena.h>
+
+#include <array>
 #include <string>
 #include <memory>
+#include <iostream>
+#include <optional>
+#include <vector>
 
 namespace serialization {
     
+// Версия схемы, в которой остановки и автобусы ссылаются друг на друга по номерам
+inline constexpr uint32_t INDEXED_VERSION = 1;
+    
+enum class BaseFormat {
+    PROTOBUF,
+    FLAT
+};
+    
+enum class Compression {
+    NONE,
+    GZIP
+};
+    
+struct SerializationSettings {
+    std::string file;
+    BaseFormat format = BaseFormat::PROTOBUF;
+    // Только для базы protobuf
+    Compression compression = Compression::NONE;
+    // make_base: если задан, в file пишется дельта относительно parent с уже выпущенными deltas
+    std::string parent;
+    // Дельты, которые по порядку накладываются на базу
+    std::vector<std::string> deltas;
+    // make_base: сохранить в базе готовую карту, чтобы process_requests не рисовал её
+    bool prerender_map = false;
+};
+    
+// Части базы, которые нужны для ответа на запросы; справочник загружается всегда
+struct BaseParts {
+    bool render_settings = true;
+    bool router = true;
+    // Без сохранённого графа маршрутизатор строит его по справочнику при первом запросе маршрута.
+    // Плоская база отображается в память целиком, и для неё флаг не важен
+    bool graph = true;
+};
+    
 class Serializer {
 public:
     explicit Serializer(tcat::TransportCatalogue& catalogue, std::shared_ptr<router::TransportRouter> tr, map_r::MapRenderer& map_renderer);
     
-    void SerializeToFile(const std::string& file);
+    // Запись базы идёт стадиями. Каждая кодирует свои секции, как только готово то, из чего они
+    // собираются, и разные стадии могут идти параллельно; файл пишет WriteEncodedSections
+    void EncodeCatalogueSections(Compression compression);
+    // Строит граф, если он ещё не построен: он хранится в базе, чтобы process_requests не строил его заново
+    void EncodeGraphSection(Compression compression);
+    // Секция есть, только если карта уже отрисована
+    void EncodeRenderedMapSection(Compression compression);
+    void WriteEncodedSections(const std::string& file, Compression compression);
+    // Пишет в file только отличия справочника и настроек от parent с наложенными parent_deltas
+    void SerializeDeltaToFile(const std::string& file, const std::string& parent,
+                              const std::vector<std::string>& parent_deltas = {});
     
-    std::shared_ptr<router::TransportRouter> DeserializeFromFile(const std::string& file);
+    // Возвращает nullptr, если маршрутизатор не запрошен
+    std::shared_ptr<router::TransportRouter> DeserializeFromFile(const std::string& file, BaseParts parts = {},
+                                                                 const std::vector<std::string>& deltas = {});
     
 private:
     tcat::TransportCatalogue& tc_;
@@ -26,24 +80,40 @@ private:
     map_r::MapRenderer& mr_;
    // std::shared_ptr<router::TransportRouter>& tr_;
     
-    proto_serialization::TransportCatalogue proto_tc_;
+    // Все сообщения базы размещаются в арене и освобождаются вместе с сериализатором
+    google::protobuf::Arena arena_;
+    proto_serialization::TransportCatalogue* proto_tc_;
+    // Закодированные секции по номерам BaseSection::Id; каждая стадия пишет только свои
+    std::array<std::optional<std::string>, proto_serialization::BaseSection::Id_ARRAYSIZE> encoded_sections_;
     
     void SerializeStops();
     void SerializeBuses();
     void SerializeDistances();
     void SerializeRenderSettings();
     void SerializeRouterSettings();
-    void SerializeGraph();
-    void SerializeTransportRouter();
+    void SerializeGraph(proto_serialization::Graph& proto_graph) const;
+    void SerializeNameIndex(const phash::NameIndex& index, proto_serialization::NameIndex& proto_index) const;
+    
+    // Читает из базы с оглавлением только нужные секции; false — база старого формата
+    bool ReadSections(std::istream& input, BaseParts parts);
+    // Загружает базу в proto_tc_ и накладывает на неё дельты
+    void ReadBase(const std::string& file, BaseParts parts, const std::vector<std::string>& deltas);
     
     void DeserializeCatalogue();
+    void DeserializeDistances();
+    void DeserializeBuses();
     void DeserializeRenderSettings();
     router::RouterSettings DeserializeRouterSettings();
-    graph::DirectedWeightedGraph<double> DeserializeGraph();
-    std::shared_ptr<router::TransportRouter> DeserializeTransportRouter();
-    
-    proto_serialization::Color SerializeColor(const svg::Color& color) const;
-    svg::Color DeserializeColor(const proto_serialization::Color& proto_color) const;
+    // Не обращается к справочнику, поэтому может выполняться параллельно с DeserializeCatalogue
+    graph::DirectedWeightedGraph<double> DeserializeGraph() const;
+    std::shared_ptr<router::TransportRouter> DeserializeTransportRouter(graph::DirectedWeightedGraph<double> graph);
+    phash::NameIndex DeserializeNameIndex(const proto_serialization::NameIndex& proto_index) const;
 };
     
+proto_serialization::RenderSettings SerializeRenderSettings(const map_r::RenderSettings& settings);
+map_r::RenderSettings DeserializeRenderSettings(const proto_serialization::RenderSettings& proto_settings);
+    
+proto_serialization::RouterSettings SerializeRouterSettings(const router::RouterSettings& settings);
+router::RouterSettings DeserializeRouterSettings(const proto_serialization::RouterSettings& proto_settings);
+    
 } // namespace serialization
@@ -0,0 +1,352 @@
+#include "server.h"
+#include "json_writer.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace server {
+
+namespace {
+// Соединение оборвалось или прислало не то; сервер на сокете закрывает его и ждёт следующего
+class ConnectionError : public runtime_error {
+public:
+    using runtime_error::runtime_error;
+};
+
+constexpr size_t READ_SIZE = 1 << 16;
+
+volatile sig_atomic_t stop_requested = 0;
+// Сервер на сокете блокирует SIGINT и SIGTERM и ждёт ввода с маской wait_signals: сигнал
+// остановки приходит только во время ожидания, и начатый пакет всегда отвечается целиком
+bool wait_for_signals = false;
+sigset_t wait_signals;
+
+void RequestStop(int) {
+    stop_requested = 1;
+}
+
+string ErrorText(string_view what) {
+    string text(what);
+    text += ": "sv;
+    text += strerror(errno);
+    return text;
+}
+
+// false — пришёл сигнал остановки
+bool WaitReadable(int fd) {
+    if (!wait_for_signals) {
+        return true;
+    }
+    pollfd descriptor{fd, POLLIN, 0};
+    while (!stop_requested) {
+        if (ppoll(&descriptor, 1, nullptr, &wait_signals) >= 0) {
+            return true;
+        }
+        if (errno != EINTR) {
+            throw ConnectionError(ErrorText("Cannot wait for input"sv));
+        }
+    }
+    return false;
+}
+
+// false — читатель закрыл соединение
+bool WriteAll(int fd, string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EPIPE || errno == ECONNRESET) {
+                return false;
+            }
+            throw ConnectionError(ErrorText("Cannot write response"sv));
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    return true;
+}
+
+class Descriptor {
+public:
+    explicit Descriptor(int fd) : fd_(fd) {}
+    Descriptor(const Descriptor&) = delete;
+    Descriptor& operator=(const Descriptor&) = delete;
+    ~Descriptor() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    int Get() const {
+        return fd_;
+    }
+
+private:
+    int fd_;
+};
+
+sockaddr_un MakeAddress(const string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("Bad socket path "s + path);
+    }
+    copy(path.begin(), path.end(), address.sun_path);
+    return address;
+}
+
+// -1, если на path никто не слушает
+int Connect(const string& path) {
+    const sockaddr_un address = MakeAddress(path);
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw runtime_error(ErrorText("Cannot create socket"sv));
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Слушающий сокет; файл сокета удаляется вместе с ним
+class Listener {
+public:
+    explicit Listener(const string& path);
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+    ~Listener();
+
+    // -1 — пришёл сигнал остановки
+    int Accept();
+
+private:
+    string path_;
+    int fd_ = -1;
+};
+
+Listener::Listener(const string& path) : path_(path) {
+    const sockaddr_un address = MakeAddress(path);
+    struct stat file_stat{};
+    if (lstat(path.c_str(), &file_stat) == 0 && S_ISSOCK(file_stat.st_mode)) {
+        // Сокет остался от прошлого запуска, если на нём уже никто не слушает
+        const int other = Connect(path);
+        if (other >= 0) {
+            close(other);
+            throw runtime_error("Another server is listening on "s + path);
+        }
+        unlink(path.c_str());
+    }
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        throw runtime_error(ErrorText("Cannot create socket"sv));
+    }
+    if (bind(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        const string error = ErrorText("Cannot bind socket "s + path);
+        close(fd_);
+        throw runtime_error(error);
+    }
+    if (listen(fd_, SOMAXCONN) != 0) {
+        const string error = ErrorText("Cannot listen on socket "s + path);
+        close(fd_);
+        unlink(path.c_str());
+        throw runtime_error(error);
+    }
+}
+
+Listener::~Listener() {
+    close(fd_);
+    unlink(path_.c_str());
+}
+
+int Listener::Accept() {
+    while (true) {
+        if (!WaitReadable(fd_)) {
+            return -1;
+        }
+        const int connection = accept(fd_, nullptr, nullptr);
+        if (connection >= 0) {
+            return connection;
+        }
+        if (errno != EINTR && errno != ECONNABORTED) {
+            throw runtime_error(ErrorText("Cannot accept connection"sv));
+        }
+    }
+}
+
+string ErrorResponse(string_view message) {
+    string response;
+    json::Writer writer(response, json::Writer::Style::COMPACT);
+    writer.StartDict().Key("error_message"sv).Value(message).EndDict();
+    return response;
+}
+
+void Serve(io::JsonReader& reader, Channel& channel) {
+    string frame;
+    ostringstream output;
+    while (channel.ReadFrame(frame)) {
+        output.str({});
+        string response;
+        try {
+            reader.AnswerBatch(frame, output);
+            response = output.str();
+        } catch (const io::BatchError& e) {
+            response = ErrorResponse(e.what());
+        }
+        if (!channel.WriteFrame(response)) {
+            return;
+        }
+    }
+}
+} // namespace
+
+Channel::Channel(int input_fd, int output_fd, Framing framing) : input_fd_(input_fd), output_fd_(output_fd), framing_(framing) {}
+
+bool Channel::ReadFrame(string& frame) {
+    // Вход дочитывается, пока в нём нет перевода строки; уже просмотренное не просматривается снова
+    size_t line_end = 0;
+    while ((line_end = buffer_.find('\n', line_end)) == string::npos) {
+        line_end = buffer_.size();
+        if (!Fill()) {
+            if (buffer_.empty() || stop_requested) {
+                return false;
+            }
+            if (framing_ == Framing::LENGTH) {
+                throw ConnectionError("Input ends in the middle of a frame"s);
+            }
+            // Последняя строка без перевода строки
+            frame = move(buffer_);
+            buffer_.clear();
+            return true;
+        }
+    }
+    if (framing_ == Framing::LINES) {
+        frame.assign(buffer_, 0, line_end > 0 && buffer_[line_end - 1] == '\r' ? line_end - 1 : line_end);
+        buffer_.erase(0, line_end + 1);
+        return true;
+    }
+
+    size_t size = 0;
+    const char* header_end = buffer_.data() + (line_end > 0 && buffer_[line_end - 1] == '\r' ? line_end - 1 : line_end);
+    const auto [end, error] = from_chars(buffer_.data(), header_end, size);
+    if (error != errc() || end != header_end || line_end == 0) {
+        throw ConnectionError("Malformed frame length"s);
+    }
+    const size_t frame_begin = line_end + 1;
+    while (buffer_.size() - frame_begin < size) {
+        if (!Fill()) {
+            throw ConnectionError("Input ends in the middle of a frame"s);
+        }
+    }
+    frame.assign(buffer_, frame_begin, size);
+    buffer_.erase(0, frame_begin + size);
+    return true;
+}
+
+bool Channel::WriteFrame(string_view frame) {
+    if (framing_ == Framing::LINES) {
+        return WriteAll(output_fd_, frame) && WriteAll(output_fd_, "\n"sv);
+    }
+    const string header = to_string(frame.size()) + '\n';
+    return WriteAll(output_fd_, header) && WriteAll(output_fd_, frame);
+}
+
+bool Channel::Fill() {
+    if (!WaitReadable(input_fd_)) {
+        return false;
+    }
+    const size_t size = buffer_.size();
+    buffer_.resize(size + READ_SIZE);
+    ssize_t read_size = 0;
+    do {
+        read_size = read(input_fd_, buffer_.data() + size, READ_SIZE);
+    } while (read_size < 0 && errno == EINTR);
+    buffer_.resize(size + static_cast<size_t>(max<ssize_t>(read_size, 0)));
+    if (read_size < 0) {
+        throw ConnectionError(ErrorText("Cannot read request"sv));
+    }
+    return read_size > 0;
+}
+
+void ServeStdio(io::JsonReader& reader, Framing framing) {
+    signal(SIGPIPE, SIG_IGN);
+    Channel channel(STDIN_FILENO, STDOUT_FILENO, framing);
+    Serve(reader, channel);
+}
+
+void ServeSocket(io::JsonReader& reader, Framing framing, const string& path) {
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction action{};
+    action.sa_handler = RequestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    // Маска ставится до первого пакета, и потоки, отвечающие на запросы, её наследуют
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &wait_signals);
+    wait_for_signals = true;
+
+    Listener listener(path);
+    while (true) {
+        const Descriptor connection(listener.Accept());
+        if (connection.Get() < 0) {
+            break;
+        }
+        Channel channel(connection.Get(), connection.Get(), framing);
+        try {
+            Serve(reader, channel);
+        } catch (const ConnectionError& e) {
+            cerr << e.what() << '\n';
+        }
+    }
+}
+
+void SendBatch(const string& path, Framing framing, istream& input, ostream& output) {
+    signal(SIGPIPE, SIG_IGN);
+    const Descriptor connection(Connect(path));
+    if (connection.Get() < 0) {
+        throw runtime_error(ErrorText("Cannot connect to "s + path));
+    }
+    ostringstream batch_stream;
+    batch_stream << input.rdbuf();
+    string batch = batch_stream.str();
+    if (framing == Framing::LINES) {
+        // Вне строк JSON переводы строк — просто пробелы, а внутри строк их быть не может
+        replace(batch.begin(), batch.end(), '\n', ' ');
+        replace(batch.begin(), batch.end(), '\r', ' ');
+    }
+
+    Channel channel(connection.Get(), connection.Get(), framing);
+    string response;
+    bool answered = channel.WriteFrame(batch);
+    if (answered) {
+        // Больше пакетов не будет: сервер ответит и закроет соединение
+        shutdown(connection.Get(), SHUT_WR);
+        answered = channel.ReadFrame(response);
+    }
+    if (!answered) {
+        throw runtime_error("Server closed the connection without a response"s);
+    }
+    output << response;
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "json_reader.h"
+
+namespace server {
+
+// Как отделяются документы друг от друга: длиной в байтах с переводом строки перед документом
+// или переводом строки после документа (тогда документ записан в одну строку)
+enum class Framing {
+    LENGTH,
+    LINES
+};
+
+// Читает документы из input_fd и пишет ответы в output_fd
+class Channel {
+public:
+    Channel(int input_fd, int output_fd, Framing framing);
+    // false — вход кончился между документами
+    bool ReadFrame(std::string& frame);
+    // false — читатель закрыл соединение
+    bool WriteFrame(std::string_view frame);
+
+private:
+    int input_fd_;
+    int output_fd_;
+    Framing framing_;
+    std::string buffer_;
+
+    // false — конец входа
+    bool Fill();
+};
+
+// Отвечает на документы process_requests из stdin, пока он не кончится; база загружается один раз.
+// Ответ на пакет — тот же массив, что печатает process_requests, а при ошибке в пакете —
+// словарь {"error_message": ...}
+void ServeStdio(io::JsonReader& reader, Framing framing);
+// То же на Unix-сокете path; соединения обслуживаются по очереди до SIGINT или SIGTERM
+void ServeSocket(io::JsonReader& reader, Framing framing, const std::string& path);
+// Отправляет серверу на сокете path весь input одним пакетом и печатает ответ в output
+void SendBatch(const std::string& path, Framing framing, std::istream& input, std::ostream& output);
+
+}
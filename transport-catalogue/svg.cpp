@@ -49,7 +49,7 @@ void Object::Render(const RenderContext& context) const {
     // Делегируем вывод тега своим подклассам
     RenderObject(context);
 
-    context.out << std::endl;
+    context.out.put('\n');
 }
     
 
@@ -67,8 +67,13 @@ Circle& Circle::SetRadius(double radius)  {
 
 void Circle::RenderObject(const RenderContext& context) const {
     auto& out = context.out;
-    out << "<circle cx=\""sv << center_.x << "\" cy=\""sv << center_.y << "\" "sv;
-    out << "r=\""sv << radius_ << "\""sv;
+    out << "<circle cx=\""sv;
+    num::Write(out, center_.x);
+    out << "\" cy=\""sv;
+    num::Write(out, center_.y);
+    out << "\" r=\""sv;
+    num::Write(out, radius_);
+    out.put('"');
     RenderAttrs(out);
     out << "/>"sv;
 }
@@ -86,11 +91,13 @@ void Polyline::RenderObject(const RenderContext& context) const {
     bool is_first = true;
     for (const Point& point : points_) {
         if (is_first) {
-            out << point.x << ',' << point.y;
             is_first = false;
         } else {
-        out << ' ' << point.x << ',' << point.y;
+            out.put(' ');
         }
+        num::Write(out, point.x);
+        out.put(',');
+        num::Write(out, point.y);
     }
     out << "\""sv;
     RenderAttrs(out);
@@ -138,9 +145,17 @@ void Text::RenderObject(const RenderContext& context) const {
     auto& out = context.out;
     out << "<text"sv;
     RenderAttrs(out);
-    out << " x=\""sv << pos_.x << "\" y=\""sv << pos_.y << "\""sv;
-    out << " dx=\""sv << offset_.x << "\" dy=\""sv << offset_.y << "\""sv;
-    out << " font-size=\"" << font_size_ << "\""sv;
+    out << " x=\""sv;
+    num::Write(out, pos_.x);
+    out << "\" y=\""sv;
+    num::Write(out, pos_.y);
+    out << "\" dx=\""sv;
+    num::Write(out, offset_.x);
+    out << "\" dy=\""sv;
+    num::Write(out, offset_.y);
+    out << "\" font-size=\""sv;
+    num::Write(out, font_size_);
+    out.put('"');
     if (font_family_.size() > 0)
     {
         out << " font-family=\"" << font_family_ << "\""sv;
@@ -180,8 +195,8 @@ void Document::AddPtr(std::unique_ptr<Object>&& obj) {
     // Выводит в ostream svg-представление документа
 void Document::Render(std::ostream& out) const {
     RenderContext ctx(out, 2, 2);
-    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
-    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv;
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv;
     
     for (const auto& obj : objects_) {
         obj->Render(ctx);
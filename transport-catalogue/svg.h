@@ -8,6 +8,8 @@
 #include <optional>
 #include <variant>
 
+#include "number_format.h"
+
 namespace svg {
     
 enum class StrokeLineCap {
@@ -60,11 +62,25 @@ struct ColorPrinter {
     }
     void operator()(svg::Rgb rgb) const {
         using namespace std::literals;
-        out << "rgb("sv << std::to_string(rgb.red) << ',' << std::to_string(rgb.green) << ',' << std::to_string(rgb.blue) << ')';
+        out << "rgb("sv;
+        num::Write(out, rgb.red);
+        out.put(',');
+        num::Write(out, rgb.green);
+        out.put(',');
+        num::Write(out, rgb.blue);
+        out.put(')');
     }
     void operator()(svg::Rgba rgba) const {
         using namespace std::literals;
-        out << "rgba("s << std::to_string(rgba.red) << ","s << std::to_string(rgba.green) << ","s << std::to_string(rgba.blue) << ","s << rgba.opacity << ")"s;
+        out << "rgba("sv;
+        num::Write(out, rgba.red);
+        out.put(',');
+        num::Write(out, rgba.green);
+        out.put(',');
+        num::Write(out, rgba.blue);
+        out.put(',');
+        num::Write(out, rgba.opacity);
+        out.put(')');
     }
 };
 
@@ -152,7 +168,9 @@ protected:
             out << "\""sv;
         }
         if (stroke_width_) {
-            out << " stroke-width=\""sv << *stroke_width_ << "\""sv;
+            out << " stroke-width=\""sv;
+            num::Write(out, *stroke_width_);
+            out.put('"');
         }
         if (line_cap_) {
             out << " stroke-linecap=\""sv << *line_cap_ << "\""sv;
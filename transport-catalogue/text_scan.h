@@ -0,0 +1,106 @@
+#pragma once
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace scan {
+
+namespace detail {
+inline bool IsJsonSpecial(char c) {
+    return c == '"' || c == '\\' || c == '\n' || c == '\r';
+}
+inline bool IsJsonNesting(char c) {
+    return c == '"' || (c | 0x20) == '{' || (c | 0x20) == '}';
+}
+} // namespace detail
+
+// Первый из символов ", \, \n и \r в [pos, end) или end: на них останавливается разбор
+// строки JSON, и их же экранирует печать. Сравнивает по 32 байта с AVX2, по 16 с SSE2,
+// без них — по одному
+inline const char* FindJsonSpecial(const char* pos, const char* end) {
+#if defined(__AVX2__)
+    {
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+        const __m256i line_feed = _mm256_set1_epi8('\n');
+        const __m256i carriage_return = _mm256_set1_epi8('\r');
+        for (; end - pos >= 32; pos += 32) {
+            const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+            const __m256i found = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, line_feed), _mm256_cmpeq_epi8(chunk, carriage_return)));
+            if (const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(found)); mask != 0) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i line_feed = _mm_set1_epi8('\n');
+        const __m128i carriage_return = _mm_set1_epi8('\r');
+        for (; end - pos >= 16; pos += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+            const __m128i found = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, line_feed), _mm_cmpeq_epi8(chunk, carriage_return)));
+            if (const int mask = _mm_movemask_epi8(found); mask != 0) {
+                return pos + __builtin_ctz(static_cast<unsigned>(mask));
+            }
+        }
+    }
+#endif
+    while (pos != end && !detail::IsJsonSpecial(*pos)) {
+        ++pos;
+    }
+    return pos;
+}
+
+// Первая кавычка или скобка [, ], {, } в [pos, end) или end. Внутри вложенного значения
+// остальное не меняет глубину, и его можно пропускать блоками. Квадратные скобки отличаются
+// от фигурных одним битом 0x20, поэтому хватает трёх сравнений
+inline const char* FindJsonNesting(const char* pos, const char* end) {
+#if defined(__AVX2__)
+    {
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i lower = _mm256_set1_epi8(0x20);
+        const __m256i open = _mm256_set1_epi8('{');
+        const __m256i close = _mm256_set1_epi8('}');
+        for (; end - pos >= 32; pos += 32) {
+            const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+            const __m256i folded = _mm256_or_si256(chunk, lower);
+            const __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote),
+                _mm256_or_si256(_mm256_cmpeq_epi8(folded, open), _mm256_cmpeq_epi8(folded, close)));
+            if (const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(found)); mask != 0) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i lower = _mm_set1_epi8(0x20);
+        const __m128i open = _mm_set1_epi8('{');
+        const __m128i close = _mm_set1_epi8('}');
+        for (; end - pos >= 16; pos += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+            const __m128i folded = _mm_or_si128(chunk, lower);
+            const __m128i found = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)));
+            if (const int mask = _mm_movemask_epi8(found); mask != 0) {
+                return pos + __builtin_ctz(static_cast<unsigned>(mask));
+            }
+        }
+    }
+#endif
+    while (pos != end && !detail::IsJsonNesting(*pos)) {
+        ++pos;
+    }
+    return pos;
+}
+
+} // namespace scan
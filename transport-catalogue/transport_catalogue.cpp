@@ -13,6 +13,7 @@
 #include "transport_catalogue.h"
 #include "geo.h"
 #include "domain.h"
+#include "memory_report.h"
 
 using namespace std;
 
@@ -20,49 +21,73 @@ namespace tcat {
 void TransportCatalogue::AddStop(const Stop& stop) {
     stops_.push_back(move(stop));
     Stop* stop_ptr = &stops_.back();
-    stopname_to_stop_.emplace(stop_ptr->name, stop_ptr);
-    
+    stop_ptr->id = stop_points_.Add(geo::ToCoordinates(stop_ptr->coordinates));
+    if (stop_ptr->id >= stop_index_.Size()) {
+        stopname_to_stop_.emplace(stop_ptr->name, stop_ptr);
+    }
 }
     
 Stop* TransportCatalogue::FindStop(string_view stop_name) const {
+    const uint32_t id = stop_index_.Find(stop_name);
+    if (id < stops_.size() && stops_[id].name == stop_name) {
+        return const_cast<Stop*>(&stops_[id]);
+    }
     auto it = stopname_to_stop_.find(stop_name);
     return (it != stopname_to_stop_.end() ? it->second : nullptr);
 }
     
 void TransportCatalogue::AddBus(const PreBus& pre_bus) {
-    Bus bus;
-    bus.name = move(pre_bus.name);
-    bus.is_circular = pre_bus.is_circular;
-    
+    vector<Stop*> stops;
+    stops.reserve(pre_bus.stops.size());
     for (const std::string_view stop : pre_bus.stops) {
-        Stop* stop_ptr = FindStop(stop);
-        bus.stops.push_back(stop_ptr);
-        stop_to_buses_[stop_ptr].insert(bus.name);
+        stops.push_back(FindStop(stop));
     }
-    if (!pre_bus.is_circular) {
-        vector<string> pre(pre_bus.stops.begin(), pre_bus.stops.end() - 1);
-        reverse(pre.begin(), pre.end());
-        for (const auto& stop : pre) {
-            Stop* stop_ptr = FindStop(stop);
-            bus.stops.push_back(stop_ptr);
-            stop_to_buses_[stop_ptr].insert(bus.name);
-        }
+    AddBus(pre_bus.name, move(stops), pre_bus.is_circular);
+}
+    
+void TransportCatalogue::AddBus(std::string name, std::vector<Stop*> stops, bool is_circular) {
+    Bus bus;
+    bus.name = move(name);
+    bus.is_circular = is_circular;
+    bus.stops = move(stops);
+    bus.id = buses_.size();
+    for (Stop* stop_ptr : bus.stops) {
+        stop_to_buses_[stop_ptr].insert(bus.name);
     }
     buses_.push_back(move(bus));
     Bus* bus_ptr = &buses_.back();
+    const size_t bus_id = bus_ptr->id;
     bus_ptr->number_of_stops = CalculateStops(bus_ptr);
     bus_ptr->unique_stops = CalculateUniqueStops(bus_ptr);
     auto pair_dist_curvature = CalculateRouteLength(bus_ptr);
     bus_ptr->route_length = move(pair_dist_curvature.first);
     bus_ptr->curvature = move(pair_dist_curvature.second);
     
-    busname_to_bus_.emplace(buses_.back().name, bus_ptr);
+    if (bus_id >= bus_index_.Size()) {
+        busname_to_bus_.emplace(bus_ptr->name, bus_ptr);
+    }
+}
+void TransportCatalogue::AddBus(Bus bus) {
+    bus.id = buses_.size();
+    for (Stop* stop_ptr : bus.stops) {
+        stop_to_buses_[stop_ptr].insert(bus.name);
+    }
+    buses_.push_back(move(bus));
+    if (buses_.size() - 1 >= bus_index_.Size()) {
+        busname_to_bus_.emplace(buses_.back().name, &buses_.back());
+    }
+}
+    
+Stop* TransportCatalogue::GetStop(size_t id) const {
+    return const_cast<Stop*>(&stops_.at(id));
 }
     
 Bus* TransportCatalogue::FindBus(string_view bus_name) const {
-    auto it = busname_to_bus_.find(bus_name);
-    if (it != busname_to_bus_.end()) {
+    const uint32_t id = bus_index_.Find(bus_name);
+    if (id < buses_.size() && buses_[id].name == bus_name) {
+        return const_cast<Bus*>(&buses_[id]);
     }
+    auto it = busname_to_bus_.find(bus_name);
     return (it != busname_to_bus_.end() ? it->second : nullptr);
 }
     
@@ -116,12 +141,42 @@ size_t TransportCatalogue::GetAllStopsCount() const {
     return stops_.size();
 }
     
-const unordered_map<string_view, Stop*>& TransportCatalogue::GetAllStops() const {
-    return stopname_to_stop_;
+const deque<Stop>& TransportCatalogue::GetAllStops() const {
+    return stops_;
 }
     
-const unordered_map<string_view, Bus*>& TransportCatalogue::GetAllBuses() const {
-    return busname_to_bus_;
+const deque<Bus>& TransportCatalogue::GetAllBuses() const {
+    return buses_;
+}
+    
+void TransportCatalogue::BuildNameIndex() {
+    vector<string_view> stop_names;
+    stop_names.reserve(stops_.size());
+    for (const Stop& stop : stops_) {
+        stop_names.push_back(stop.name);
+    }
+    vector<string_view> bus_names;
+    bus_names.reserve(buses_.size());
+    for (const Bus& bus : buses_) {
+        bus_names.push_back(bus.name);
+    }
+    stop_index_ = phash::NameIndex(stop_names);
+    bus_index_ = phash::NameIndex(bus_names);
+    stopname_to_stop_ = {};
+    busname_to_bus_ = {};
+}
+    
+void TransportCatalogue::SetNameIndex(phash::NameIndex stop_index, phash::NameIndex bus_index) {
+    stop_index_ = move(stop_index);
+    bus_index_ = move(bus_index);
+}
+    
+const phash::NameIndex& TransportCatalogue::GetStopIndex() const {
+    return stop_index_;
+}
+    
+const phash::NameIndex& TransportCatalogue::GetBusIndex() const {
+    return bus_index_;
 }
     
 const unordered_map<pair<Stop*, Stop*>, size_t, detail::StopPairHasher>& TransportCatalogue::GetAllDistances() const {
@@ -139,8 +194,46 @@ size_t TransportCatalogue::GetDistance(Stop* from, Stop* to) const {
     return distance_between_stops_.at({from, to});
 }
     
+mem::ComponentUsage TransportCatalogue::GetMemoryUsage() const {
+    mem::ComponentUsage stops{"stops", mem::DequeBytes(stops_), {}};
+    for (const Stop& stop : stops_) {
+        stops.bytes += mem::StringBytes(stop.name);
+    }
+    
+    mem::ComponentUsage stop_points{"stop coordinates (SoA)", 0, {}};
+    for (const auto* column : {&stop_points_.Lat(), &stop_points_.Lng(), &stop_points_.SinLat(),
+                               &stop_points_.CosLat(), &stop_points_.SinLng(), &stop_points_.CosLng()}) {
+        stop_points.bytes += mem::VectorBytes(*column);
+    }
+    
+    mem::ComponentUsage buses{"buses", mem::DequeBytes(buses_), {}};
+    for (const Bus& bus : buses_) {
+        buses.bytes += mem::StringBytes(bus.name) + mem::VectorBytes(bus.stops);
+    }
+    
+    mem::ComponentUsage stop_to_buses{"stop to buses", mem::HashTableBytes(stop_to_buses_), {}};
+    for (const auto& [_, bus_names] : stop_to_buses_) {
+        stop_to_buses.bytes += mem::TreeBytes(bus_names);
+        for (const string& bus_name : bus_names) {
+            stop_to_buses.bytes += mem::StringBytes(bus_name);
+        }
+    }
+    
+    return {"catalogue", sizeof(*this), {
+        move(stops),
+        move(stop_points),
+        move(buses),
+        stop_index_.GetMemoryUsage("stop name index"s),
+        bus_index_.GetMemoryUsage("bus name index"s),
+        {"stop name map (build time)", mem::HashTableBytes(stopname_to_stop_), {}},
+        {"bus name map (build time)", mem::HashTableBytes(busname_to_bus_), {}},
+        move(stop_to_buses),
+        {"distances", mem::HashTableBytes(distance_between_stops_), {}}
+    }};
+}
+    
 int TransportCatalogue::CalculateStops(const Bus* bus_ptr) const {
-        return bus_ptr->stops.size();
+    return bus_ptr->GetRouteSize();
 }
     
 int TransportCatalogue::CalculateUniqueStops(const Bus* bus_ptr) const {
@@ -152,17 +245,23 @@ int TransportCatalogue::CalculateUniqueStops(const Bus* bus_ptr) const {
     
 pair<int, double> TransportCatalogue::CalculateRouteLength(const Bus* bus_ptr) const {
     int route_length = 0;
-    double coord_length = 0;
-    for (size_t i = 0; i < bus_ptr->stops.size() - 1; ++i) {
-        Stop* first = FindStop(bus_ptr->stops[i]->name);
-        Stop* second = FindStop(bus_ptr->stops[i + 1]->name);
+    vector<size_t> route_ids;
+    route_ids.reserve(bus_ptr->GetRouteSize());
+    Stop* first = nullptr;
+    for (Stop* second : bus_ptr->GetRoute()) {
+        route_ids.push_back(second->id);
+        if (!first) {
+            first = second;
+            continue;
+        }
         if (distance_between_stops_.find({first, second}) == distance_between_stops_.end()) {
             route_length += distance_between_stops_.at({second, first});
         } else {
             route_length += distance_between_stops_.at({first, second});
         }
-        coord_length += geo::ComputeDistance(first->coordinates, second->coordinates);
+        first = second;
     }
+    double coord_length = geo::ComputeRouteDistance(stop_points_, route_ids);
     return {route_length, route_length / coord_length};
 }
     
@@ -10,6 +10,9 @@
 #include <map>
 
 #include "domain.h"
+#include "geo.h"
+#include "memory_report.h"
+#include "perfect_hash.h"
 
 namespace tcat {
     
@@ -22,6 +25,14 @@ public:
     
     void AddBus(const PreBus& pre_bus);
     
+    // Добавляет автобус по уже найденным остановкам маршрута
+    void AddBus(std::string name, std::vector<Stop*> stops, bool is_circular);
+    
+    // Добавляет автобус с уже посчитанной статистикой маршрута
+    void AddBus(Bus bus);
+    
+    Stop* GetStop(size_t id) const;
+    
     Bus* FindBus(std::string_view bus_name) const;
     
     BusInfo GetBusInfo(std::string_view bus_name) const;
@@ -36,17 +47,35 @@ public:
     
     size_t GetAllStopsCount() const;
     
-    const std::unordered_map<std::string_view, Stop*>& GetAllStops() const;
+    // Остановки и автобусы в порядке добавления: номер элемента равен его id
+    const std::deque<Stop>& GetAllStops() const;
+    
+    const std::deque<Bus>& GetAllBuses() const;
     
-    const std::unordered_map<std::string_view, Bus*>& GetAllBuses() const;
+    // Строит совершенные хеш-функции по именам остановок и автобусов и
+    // освобождает промежуточные словари, которые использовались при наполнении
+    void BuildNameIndex();
+    
+    // Принимает готовые индексы до добавления остановок и автобусов,
+    // например при загрузке из базы
+    void SetNameIndex(phash::NameIndex stop_index, phash::NameIndex bus_index);
+    
+    const phash::NameIndex& GetStopIndex() const;
+    
+    const phash::NameIndex& GetBusIndex() const;
     
     const std::unordered_map<std::pair<Stop*, Stop*>, size_t, detail::StopPairHasher>& GetAllDistances() const;
     
     size_t GetDistance(Stop* from, Stop* to) const;
     
+    mem::ComponentUsage GetMemoryUsage() const;
+    
 private:
     std::deque<Stop> stops_;
+    geo::SphericalPoints stop_points_;
     std::deque<Bus> buses_;
+    phash::NameIndex stop_index_;
+    phash::NameIndex bus_index_;
     std::unordered_map<std::string_view, Stop*> stopname_to_stop_;
     std::unordered_map<std::string_view, Bus*> busname_to_bus_;
     std::unordered_map<Stop*, std::set<std::string>> stop_to_buses_;
@@ -2,9 +2,11 @@
 
 #include "graph.h"
 #include "router.h"
+#include "memory_report.h"
 
 #include <utility>
 #include <memory>
+#include <stdexcept>
 #include <string_view>
 
 using namespace std;
@@ -16,11 +18,15 @@ TransportRouter::TransportRouter(tcat::TransportCatalogue& tc) : tc_(tc), graph_
 	//BuildGraph();
 }
     
-TransportRouter::TransportRouter(tcat::TransportCatalogue& tc, graph::DirectedWeightedGraph<double> graph
-                   , std::unordered_map<std::string, size_t> wait_vertexes
-                   , std::unordered_map<std::string, size_t> travel_vertexes) 
-    : tc_(tc), graph_(graph), wait_vertexes_(wait_vertexes), travel_vertexes_(travel_vertexes) {
-        router_ = make_unique<graph::Router<double>>(graph);
+// Таблица маршрутов по готовому графу строится при первом запросе маршрута
+TransportRouter::TransportRouter(tcat::TransportCatalogue& tc, graph::DirectedWeightedGraph<double> graph)
+    : tc_(tc), graph_(move(graph)) {
+    }
+    
+TransportRouter::TransportRouter(tcat::TransportCatalogue& tc, graph::DirectedWeightedGraph<double> graph,
+                                 const graph::Router<double>::RouteEntry* routes_table, shared_ptr<const void> table_owner)
+    : tc_(tc), graph_(move(graph)), table_owner_(move(table_owner)) {
+        router_ = make_unique<graph::Router<double>>(graph_, routes_table);
     }
     
 void TransportRouter::LoadSettings(RouterSettings settings) {
@@ -35,19 +41,62 @@ const graph::DirectedWeightedGraph<double>& TransportRouter::GetGraph() const {
     return graph_;
 }
     
-const unordered_map<std::string, size_t>& TransportRouter::GetWaitVertexes() const {
-    return wait_vertexes_;
+const graph::Router<double>* TransportRouter::GetRouter() const {
+    return router_.get();
+}
+    
+graph::VertexId TransportRouter::GetWaitVertex(const tcat::Stop& stop) {
+    return stop.id * 2;
 }
-const unordered_map<std::string, size_t>& TransportRouter::GetTravelVertexes() const {
-    return travel_vertexes_;
+    
+graph::VertexId TransportRouter::GetTravelVertex(const tcat::Stop& stop) {
+    return stop.id * 2 + 1;
 }
     
-RouteData TransportRouter::CalculateRoute(string from, string to) {
+void TransportRouter::BuildRouter() {
     if (!router_) {
         BuildGraph();
+        router_ = make_unique<graph::Router<double>>(graph_);
+    }
+}
+    
+mem::ComponentUsage TransportRouter::GetMemoryUsage() const {
+    mem::ComponentUsage edges{"edges", mem::VectorBytes(graph_.GetAllEdges()), {}};
+    for (const auto& edge : graph_.GetAllEdges()) {
+        edges.bytes += mem::StringBytes(edge.name);
+    }
+    mem::ComponentUsage incidence_lists{"incidence lists", mem::VectorBytes(graph_.GetAllIncidenceLists()), {}};
+    for (const auto& incidence_list : graph_.GetAllIncidenceLists()) {
+        incidence_lists.bytes += mem::VectorBytes(incidence_list);
+    }
+    mem::ComponentUsage graph{"graph", sizeof(graph_), {move(edges), move(incidence_lists)}};
+    
+    // Таблица из отображённого файла не занимает собственной памяти процесса
+    mem::ComponentUsage routes_table{"routing table (not built)", 0, {}};
+    if (router_) {
+        const size_t owned_bytes = router_->GetOwnedTableBytes();
+        routes_table = {owned_bytes == 0 ? "routing table (mapped)" : "routing table",
+                        sizeof(*router_) + owned_bytes, {}};
+    }
+    return {"transport router", sizeof(*this), {move(graph), move(routes_table)}};
+}
+    
+RouteData TransportRouter::CalculateRoute(string_view from, string_view to) {
+    BuildRouter();
+    return FindRoute(from, to);
+}
+    
+RouteData TransportRouter::FindRoute(string_view from, string_view to) const {
+    if (!router_) {
+        throw logic_error("Router is not built"s);
     }
     RouteData result;
-    auto calculated_route = router_->BuildRoute(wait_vertexes_.at(from), wait_vertexes_.at(to));
+    const tcat::Stop* from_stop = tc_.FindStop(from);
+    const tcat::Stop* to_stop = tc_.FindStop(to);
+    if (!from_stop || !to_stop) {
+        return result;
+    }
+    auto calculated_route = router_->BuildRoute(GetWaitVertex(*from_stop), GetWaitVertex(*to_stop));
     
     if (calculated_route) {
         result.is_found = true;
@@ -66,35 +115,34 @@ RouteData TransportRouter::CalculateRoute(string from, string to) {
 }
     
 void TransportRouter::BuildGraph() {
-    size_t vertex_id = 0;
-    
-    for (const auto& [_, stop_ptr] : tc_.GetAllStops()) {
-	string name = stop_ptr->name;
-        wait_vertexes_[name] = vertex_id++;
-        travel_vertexes_[name] = vertex_id++;
-            
+    // У каждой остановки есть ребро ожидания, так что у построенного графа рёбра есть всегда
+    if (graph_.GetEdgeCount() > 0) {
+        return;
+    }
+    for (const tcat::Stop& stop : tc_.GetAllStops()) {
         graph_.AddEdge({
-            wait_vertexes_.at(name),
-            travel_vertexes_.at(name),
-	    name,
+            GetWaitVertex(stop),
+            GetTravelVertex(stop),
+            stop.name,
             graph::EdgeType::WAIT,
             0,
             settings_.bus_wait_time * 1.0
         });
     }
     
-    for (const auto& [_, bus_ptr] : tc_.GetAllBuses()) {
-        for (size_t it_from = 0; it_from < bus_ptr->stops.size() - 1; ++it_from) {
+    for (const tcat::Bus& bus : tc_.GetAllBuses()) {
+        const size_t route_size = bus.GetRouteSize();
+        for (size_t it_from = 0; it_from + 1 < route_size; ++it_from) {
             int span_count = 0;
-            for (size_t it_to = it_from + 1; it_to < bus_ptr->stops.size(); ++it_to) {
+            for (size_t it_to = it_from + 1; it_to < route_size; ++it_to) {
                 double road_length = 0.0;
                 for (size_t it = it_from + 1; it <= it_to; ++it) {
-                    road_length += static_cast<double>(tc_.GetDistance(bus_ptr->stops[it - 1], bus_ptr->stops[it]));
+                    road_length += static_cast<double>(tc_.GetDistance(bus.GetRouteStop(it - 1), bus.GetRouteStop(it)));
                 }
                 graph_.AddEdge({
-                    travel_vertexes_.at(bus_ptr->stops.at(it_from)->name),
-                    wait_vertexes_.at(bus_ptr->stops.at(it_to)->name),
-		    bus_ptr->name,
+                    GetTravelVertex(*bus.GetRouteStop(it_from)),
+                    GetWaitVertex(*bus.GetRouteStop(it_to)),
+		    bus.name,
                     graph::EdgeType::TRAVEL,
                     ++span_count,
                     road_length / (settings_.bus_velocity * 1000. / 60.)
@@ -102,7 +150,6 @@ void TransportRouter::BuildGraph() {
             }
         }
     }
-    router_ = make_unique<graph::Router<double>>(graph_);
 }
     
 }
@@ -3,6 +3,7 @@
 #include "graph.h"
 #include "router.h"
 #include "transport_catalogue.h"
+#include "memory_report.h"
 
 #include <string_view>
 #include <unordered_map>
@@ -31,31 +32,41 @@ struct RouteData {
 class TransportRouter {
 public:
     TransportRouter(tcat::TransportCatalogue& catalogue);
-    TransportRouter(tcat::TransportCatalogue& catalogue, graph::DirectedWeightedGraph<double> graph
-                   , std::unordered_map<std::string, size_t> wait_vertexes
-                   , std::unordered_map<std::string, size_t> travel_vertexes);
+    TransportRouter(tcat::TransportCatalogue& catalogue, graph::DirectedWeightedGraph<double> graph);
+    // Использует готовую таблицу маршрутов; table_owner продлевает жизнь её хранилищу
+    TransportRouter(tcat::TransportCatalogue& catalogue, graph::DirectedWeightedGraph<double> graph,
+                    const graph::Router<double>::RouteEntry* routes_table, std::shared_ptr<const void> table_owner);
     
     void LoadSettings(RouterSettings settings);
     const RouterSettings& GetSettings() const;
     
     const graph::DirectedWeightedGraph<double>& GetGraph() const;
-    const std::unordered_map<std::string, size_t>& GetWaitVertexes() const;
-    const std::unordered_map<std::string, size_t>& GetTravelVertexes() const;
+    // nullptr, пока маршрутизатор не построен
+    const graph::Router<double>* GetRouter() const;
     
-    RouteData CalculateRoute(std::string from, std::string to);
+    // Каждой остановке соответствуют две вершины: ожидание и отправление
+    static graph::VertexId GetWaitVertex(const tcat::Stop& stop);
+    static graph::VertexId GetTravelVertex(const tcat::Stop& stop);
     
+    // Строит маршрутизатор при первом вызове
+    RouteData CalculateRoute(std::string_view from, std::string_view to);
+    // Только читает уже построенный маршрутизатор, поэтому может вызываться из нескольких потоков
+    RouteData FindRoute(std::string_view from, std::string_view to) const;
+    
+    // Строит граф, если он ещё не построен
+    void BuildGraph();
+    // Строит граф и таблицу маршрутов, если они ещё не построены
+    void BuildRouter();
+    
+    mem::ComponentUsage GetMemoryUsage() const;
     
 private:
     tcat::TransportCatalogue& tc_;
     RouterSettings settings_;
     
-    std::unordered_map<std::string, size_t> wait_vertexes_;
-    std::unordered_map<std::string, size_t> travel_vertexes_;
-    
     graph::DirectedWeightedGraph<double> graph_;
     std::unique_ptr<graph::Router<double>> router_ = nullptr;
-    
-    void BuildGraph();
+    std::shared_ptr<const void> table_owner_;
     
 };
     